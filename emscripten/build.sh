@@ -5,10 +5,19 @@ BuildDir="build"
 
 if [ "$1" = "clean" ]; then
 	echo "Clean tgb_dual"
-	rm -rf "./$BuildDir"
+	rm -rf "./$BuildDir" "./${BuildDir}_native"
 	exit 0
 fi
 
+if [ "$1" = "native" ]; then
+	# emscripten を使わずにネイティブのツール (tgb_headless 等) を作る
+	echo "Build native tools"
+	mkdir -p "./${BuildDir}_native"
+	cd "./${BuildDir}_native"
+	cmake $SrcDir && make
+	exit $?
+fi
+
 echo "Build tgb_dual"
 
 command -v emconfigure >/dev/null 2>&1 || { echo >&2 "emconfigure not found. Aborting."; exit 1; }
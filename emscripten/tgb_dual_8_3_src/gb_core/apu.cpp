@@ -22,30 +22,31 @@
 
 #define UPDATE_INTERVAL 172 // 1/256秒あたりのサンプル数
 #define CLOKS_PER_INTERVAL 16384 // 1/256秒あたりのクロック数 (4MHz時)
+#define SAMPLE_RATE 44100 // 出力サンプリング周波数
+#define CLOCKS_PER_SECOND 4194304 // 1秒あたりのクロック数 (4MHz時)
 
 #include "gb.h"
+#include "bench.h"
 #include <stdlib.h>
 #include <memory.h>
 
-static dword sq1_cur_pos=0;
-static dword sq2_cur_pos=0;
-static dword wav_cur_pos=0;
-static dword noi_cur_pos=0;
-
 apu::apu(gb *ref)
 {
 	ref_gb=ref;
+	b_sound=true;
 	snd=new apu_snd(this);
 	reset();
 }
 
 apu::~apu()
 {
+	delete snd;
 }
 
 void apu::reset()
 {
-	//
+	bef_clock=0x7fffffff; // 最初の書き込みのクロックから数え始める
+	clocks=0;
 	snd->reset();
 }
 
@@ -63,17 +64,17 @@ byte apu::read(word adr)
 
 void apu::write(word adr,byte dat,int clock)
 {
-	static int bef_clock=clock;
-	static int clocks=0;
-
+	COUNTER(ref_gb->get_counters()->apu_writes++);
 	snd->mem[adr-0xFF10]=dat;
 
-	snd->write_que[snd->que_count].adr=adr;
-	snd->write_que[snd->que_count].dat=dat;
-	snd->write_que[snd->que_count++].clock=clock;
+	if (b_sound){ // 無効時は render で再生する必要がないのでキューに積まない
+		snd->write_que[snd->que_count].adr=adr;
+		snd->write_que[snd->que_count].dat=dat;
+		snd->write_que[snd->que_count++].clock=clock;
 
-	if (snd->que_count>=0x10000)
-		snd->que_count=0xffff;
+		if (snd->que_count>=0x10000)
+			snd->que_count=0xffff;
+	}
 
 	snd->process(adr,dat);
 
@@ -94,6 +95,35 @@ void apu::update()
 {
 }
 
+// 保存形式に含まれていない状態 (実行途中からの正確な再開用)
+void apu::save_state_ex(int *dat)
+{
+	dat[0]=bef_clock;
+	dat[1]=clocks;
+	dat[2]=snd->counter;
+	dat[3]=snd->bef_clock;
+}
+
+void apu::restore_state_ex(int *dat)
+{
+	bef_clock=dat[0];
+	clocks=dat[1];
+	snd->counter=dat[2];
+	snd->bef_clock=dat[3];
+	snd->que_count=0; // 保存時点より後の書き込みは無効
+}
+
+void apu::set_sound_enable(bool enable)
+{
+	if (enable&&!b_sound){
+		// 無効だった間の状態から再生を再開する
+		memcpy(&snd->stat_cpy,&snd->stat,sizeof(snd->stat));
+		snd->que_count=0;
+		snd->bef_clock=ref_gb->get_cpu()->get_clock();
+	}
+	b_sound=enable;
+}
+
 apu_stat *apu::get_stat()
 {
 	return &snd->stat;
@@ -117,7 +147,9 @@ apu_snd::apu_snd(apu *papu)
 	b_enable[0]=b_enable[1]=b_enable[2]=b_enable[3]=true;
 	b_echo=false;
 	b_lowpass=false;
-	counter = 0;
+	echo_pos=0;
+	pending_rest=0;
+	counter=0;
 }
 
 apu_snd::~apu_snd()
@@ -128,6 +160,15 @@ void apu_snd::reset()
 {
 	que_count=0;
 	bef_clock=0;
+	pending_rest=0;
+	counter=0;
+	sq1_cur_pos=sq2_cur_pos=wav_cur_pos=noi_cur_pos=0;
+	sq1_cur_sample=sq2_cur_sample=0;
+	wav_cur_pos2=0;
+	wav_bef_sample=wav_cur_sample=0;
+	noi_cur_sample=10000;
+	rand_shift_reg=0x7f;
+	rand_bef_degree=0;
 	memset(&stat,0,sizeof(stat));
 	stat.sq1_playing=false;
 	stat.sq2_playing=false;
@@ -149,8 +190,43 @@ void apu_snd::reset()
 	else if (ref_apu->ref_gb->get_rom()->get_info()->gb_type>=3) // GBC
 		memcpy(mem+20,gbc_init_wav,16);
 	
-	memset(filter, 0, sizeof(filter));
-	counter = 0;
+	memset(echo_buf,0,sizeof(echo_buf));
+	echo_pos=0;
+	memset(lowpass_buf,0,sizeof(lowpass_buf));
+}
+
+// 波形生成の状態 (12個)
+void apu_snd::save_state(int *dat)
+{
+	dat[0]=sq1_cur_pos;
+	dat[1]=sq2_cur_pos;
+	dat[2]=wav_cur_pos;
+	dat[3]=noi_cur_pos;
+	dat[4]=sq1_cur_sample;
+	dat[5]=sq2_cur_sample;
+	dat[6]=wav_cur_pos2;
+	dat[7]=wav_bef_sample|(wav_cur_sample<<8);
+	dat[8]=noi_cur_sample;
+	dat[9]=rand_shift_reg;
+	dat[10]=rand_bef_degree;
+	dat[11]=pending_rest;
+}
+
+void apu_snd::restore_state(int *dat)
+{
+	sq1_cur_pos=dat[0];
+	sq2_cur_pos=dat[1];
+	wav_cur_pos=dat[2];
+	noi_cur_pos=dat[3];
+	sq1_cur_sample=dat[4]&7; // sq_wav_dat の添字
+	sq2_cur_sample=dat[5]&7;
+	wav_cur_pos2=dat[6]&31;
+	wav_bef_sample=dat[7]&0xff;
+	wav_cur_sample=(dat[7]>>8)&0xff;
+	noi_cur_sample=dat[8];
+	rand_shift_reg=dat[9];
+	rand_bef_degree=dat[10]?1:0;
+	pending_rest=dat[11];
 }
 
 void apu_snd::set_enable(int ch,bool enable)
@@ -344,7 +420,6 @@ static int sq_wav_dat[4][8]={
 
 inline short apu_snd::sq1_produce(int freq)
 {
-	static dword cur_sample=0;
 	dword cur_freq;
 	short ret;
 
@@ -352,11 +427,11 @@ inline short apu_snd::sq1_produce(int freq)
 		return 15000;
 
 	if (freq){
-		ret=sq_wav_dat[stat.sq1_type&3][cur_sample]*20000-10000;
+		ret=sq_wav_dat[stat.sq1_type&3][sq1_cur_sample]*20000-10000;
 		cur_freq=((freq*8)>0x10000)?0xffff:freq*8;
 		sq1_cur_pos+=(cur_freq<<16)/44100;
 		if (sq1_cur_pos&0xffff0000){
-			cur_sample=(cur_sample+(sq1_cur_pos>>16))&7;
+			sq1_cur_sample=(sq1_cur_sample+(sq1_cur_pos>>16))&7;
 			sq1_cur_pos&=0xffff;
 		}
 	}
@@ -368,7 +443,6 @@ inline short apu_snd::sq1_produce(int freq)
 
 inline short apu_snd::sq2_produce(int freq)
 {
-	static dword cur_sample=0;
 	dword cur_freq;
 	short ret;
 
@@ -376,11 +450,11 @@ inline short apu_snd::sq2_produce(int freq)
 		return 15000;
 
 	if (freq){
-		ret=sq_wav_dat[stat.sq2_type&3][cur_sample]*20000-10000;
+		ret=sq_wav_dat[stat.sq2_type&3][sq2_cur_sample]*20000-10000;
 		cur_freq=((freq*8)>0x10000)?0xffff:freq*8;
 		sq2_cur_pos+=(cur_freq<<16)/44100;
 		if (sq2_cur_pos&0xffff0000){
-			cur_sample=(cur_sample+(sq2_cur_pos>>16))&7;
+			sq2_cur_sample=(sq2_cur_sample+(sq2_cur_pos>>16))&7;
 			sq2_cur_pos&=0xffff;
 		}
 	}
@@ -392,8 +466,6 @@ inline short apu_snd::sq2_produce(int freq)
 
 inline short apu_snd::wav_produce(int freq,bool interpolation)
 {
-	static dword cur_pos2=0;
-	static byte bef_sample=0,cur_sample=0;
 	dword cur_freq;
 	short ret;
 
@@ -402,20 +474,20 @@ inline short apu_snd::wav_produce(int freq,bool interpolation)
 
 	if (freq){
 		if (interpolation){
-			ret=(short)(((cur_sample*2500-15000)*wav_cur_pos+(bef_sample*2500-15000)*(0x10000-wav_cur_pos))/0x10000);
+			ret=(short)(((wav_cur_sample*2500-15000)*wav_cur_pos+(wav_bef_sample*2500-15000)*(0x10000-wav_cur_pos))/0x10000);
 		}
 		else{
-			ret=cur_sample*2500-15000;
+			ret=wav_cur_sample*2500-15000;
 		}
 		cur_freq=(freq>0x10000)?0xffff:freq;
 		wav_cur_pos+=(cur_freq<<16)/44100;
 		if (wav_cur_pos&0xffff0000){
-			bef_sample=cur_sample;
-			cur_pos2=(cur_pos2+(wav_cur_pos>>16))&31;
-			if (cur_pos2&1)
-				cur_sample=mem[0x20+cur_pos2/2]&0xf;
+			wav_bef_sample=wav_cur_sample;
+			wav_cur_pos2=(wav_cur_pos2+(wav_cur_pos>>16))&31;
+			if (wav_cur_pos2&1)
+				wav_cur_sample=mem[0x20+wav_cur_pos2/2]&0xf;
 			else
-				cur_sample=mem[0x20+cur_pos2/2]>>4;
+				wav_cur_sample=mem[0x20+wav_cur_pos2/2]>>4;
 			wav_cur_pos&=0xffff;
 		}
 	}
@@ -425,22 +497,20 @@ inline short apu_snd::wav_produce(int freq,bool interpolation)
 	return ret;
 }
 
-static inline unsigned int _mrand(dword degree)
+inline unsigned int apu_snd::_mrand(dword degree)
 {
-	static int shift_reg=0x7f;
-	static int bef_degree=0;
 	int xor_reg=0;
 	int masked;
 	
 	degree=(degree==7)?0:1;
 
-	if (bef_degree!=degree){
-		shift_reg&=(degree?0x7fff:0x7f);
-		if (!shift_reg) shift_reg=degree?0x7fff:0x7f;
+	if (rand_bef_degree!=degree){
+		rand_shift_reg&=(degree?0x7fff:0x7f);
+		if (!rand_shift_reg) rand_shift_reg=degree?0x7fff:0x7f;
 	}
-	bef_degree=degree;
+	rand_bef_degree=degree;
 
-	masked=shift_reg&3;
+	masked=rand_shift_reg&3;
 	while(masked)
 	{
 		xor_reg^=masked&0x01;
@@ -448,12 +518,12 @@ static inline unsigned int _mrand(dword degree)
 	}
 
 	if(xor_reg)
-		shift_reg|=(degree?0x8000:0x80);
+		rand_shift_reg|=(degree?0x8000:0x80);
 	else
-		shift_reg&=~(degree?0x8000:0x80);
-	shift_reg>>=1;
+		rand_shift_reg&=~(degree?0x8000:0x80);
+	rand_shift_reg>>=1;
 
-	return shift_reg;
+	return rand_shift_reg;
 }
 /*
 inline short apu_snd::noi_produce(int freq)
@@ -479,27 +549,26 @@ inline short apu_snd::noi_produce(int freq)
 }*/
 inline short apu_snd::noi_produce(int freq)
 {
- 	static int cur_sample=10000;
  	dword cur_freq;
  	short ret;
  	int sc;
  	if (freq){
- 		ret=cur_sample;
+ 		ret=noi_cur_sample;
  		cur_freq=freq;
  		noi_cur_pos+=cur_freq;
  		sc=0;
  		while(noi_cur_pos>44100){
  			if(sc==0)
- 				cur_sample=(_mrand(stat.noi_step)&1)?12000:-10000;
+ 				noi_cur_sample=(_mrand(stat.noi_step)&1)?12000:-10000;
 			else
- 				cur_sample+=(_mrand(stat.noi_step)&1)?12000:-10000;
-//			cur_sample=(_mrand(stat.noi_step)&0x1f)*1000;
+ 				noi_cur_sample+=(_mrand(stat.noi_step)&1)?12000:-10000;
+//			noi_cur_sample=(_mrand(stat.noi_step)&0x1f)*1000;
 			noi_cur_pos-=44100;
  			sc++;
  		}
  		
 		if(sc > 0)
- 			cur_sample /= sc;
+ 			noi_cur_sample /= sc;
  		
 		
 	}
@@ -510,8 +579,6 @@ inline short apu_snd::noi_produce(int freq)
 
 void apu_snd::update()
 {
-	static int counter=0;
-
 	if (stat.sq1_playing&&stat.master_enable){
 		if (stat.sq1_env_speed&&(counter%(4*stat.sq1_env_speed)==0)){
 			stat.sq1_vol+=(stat.sq1_env_dir?1:-1);
@@ -571,116 +638,134 @@ void apu_snd::update()
 	counter++;
 }
 
-void apu_snd::render(short *buf,int sample)
+// stems が NULL でなければ各チャンネル (SQ1,SQ2,WAV,NOI) のモノラル出力を
+// stems[0]～stems[3] に同時に書き出す (パン/マスター音量/エフェクト適用前)
+// set_enable で切ったチャンネルもステムには出力される
+void apu_snd::render_stems(short *buf,short **stems,int sample)
 {
+	BENCH_SCOPE(BENCH_SOUND);
+
+	if (!ref_apu->b_sound){
+		memset(buf,0,sample*4);
+		if (stems)
+			for (int ch=0;ch<4;ch++)
+				memset(stems[ch],0,sample*2);
+		return;
+	}
+
 	memcpy(&stat_tmp,&stat,sizeof(stat));
 	memcpy(&stat,&stat_cpy,sizeof(stat_cpy));
 
 	int tmp_l,tmp_r,tmp;
 	int now_clock=ref_apu->ref_gb->get_cpu()->get_clock();
 	int cur=0;
-	static int tmp_sample=0,now_time,bef_sample_l[5]={0,0,0,0,0},bef_sample_r[5]={0,0,0,0,0};
+	int tmp_sample=0,now_time; // static だと複数の gb を別スレッドで動かせない
 	int update_count=0;
-
-	memset(buf,0,sample*4);
-
-	for (int i=0;i<sample;i++){
-		now_time=bef_clock+(now_clock-bef_clock)*i/sample;
-
-		if ((cur!=0x10000)&&(now_time>write_que[cur].clock)&&(que_count)){
-			process(write_que[cur].adr,write_que[cur].dat);
-			cur++;
-			if (cur>=que_count)
-				cur=0x10000;
-		}
-
-		tmp_l=tmp_r=0;
-		if (stat.master_enable){
-			if (b_enable[0]&&stat.sq1_playing/*&&(stat.sq1_freq!=0x7ff)*/){
-				tmp=sq1_produce((131072/(2048-(stat.sq1_freq&0x7FF))))*stat.sq1_vol/20;
-				if (stat.ch_enable[0][0])
-					tmp_l+=tmp*stat.master_vol[0]/8;
-				if (stat.ch_enable[0][1])
-					tmp_r+=tmp*stat.master_vol[1]/8;
+	int mix_l[RENDER_BLOCK],mix_r[RENDER_BLOCK];
+
+	for (int base=0;base<sample;base+=RENDER_BLOCK){
+		int count=(sample-base<RENDER_BLOCK)?(sample-base):RENDER_BLOCK;
+
+		// 波形生成 (ブロック単位でミックス結果を溜める)
+		for (int j=0;j<count;j++){
+			int i=base+j;
+			int st[4]={0,0,0,0};
+			now_time=bef_clock+(now_clock-bef_clock)*i/sample;
+
+			if ((cur!=0x10000)&&(now_time>write_que[cur].clock)&&(que_count)){
+				process(write_que[cur].adr,write_que[cur].dat);
+				cur++;
+				if (cur>=que_count)
+					cur=0x10000;
 			}
-			if (b_enable[1]&&stat.sq2_playing/*&&(stat.sq2_freq!=0x7ff)*/){
-				tmp=sq2_produce((131072/(2048-(stat.sq2_freq&0x7FF))))*stat.sq2_vol/20;
-				if (stat.ch_enable[1][0])
-					tmp_l+=tmp*stat.master_vol[0]/8;
-				if (stat.ch_enable[1][1])
-					tmp_r+=tmp*stat.master_vol[1]/8;
+
+			tmp_l=tmp_r=0;
+			if (stat.master_enable){
+				if ((b_enable[0]||stems)&&stat.sq1_playing/*&&(stat.sq1_freq!=0x7ff)*/){
+					tmp=sq1_produce((131072/(2048-(stat.sq1_freq&0x7FF))))*stat.sq1_vol/20;
+					if (stems) st[0]=tmp;
+					if (b_enable[0]){
+						if (stat.ch_enable[0][0])
+							tmp_l+=tmp*stat.master_vol[0]/8;
+						if (stat.ch_enable[0][1])
+							tmp_r+=tmp*stat.master_vol[1]/8;
+					}
+				}
+				if ((b_enable[1]||stems)&&stat.sq2_playing/*&&(stat.sq2_freq!=0x7ff)*/){
+					tmp=sq2_produce((131072/(2048-(stat.sq2_freq&0x7FF))))*stat.sq2_vol/20;
+					if (stems) st[1]=tmp;
+					if (b_enable[1]){
+						if (stat.ch_enable[1][0])
+							tmp_l+=tmp*stat.master_vol[0]/8;
+						if (stat.ch_enable[1][1])
+							tmp_r+=tmp*stat.master_vol[1]/8;
+					}
+				}
+				if ((b_enable[2]||stems)&&stat.wav_playing/*&&(stat.wav_freq!=0x7ff)*/){
+					tmp=wav_produce((65536/(2048-(stat.wav_freq&0x7FF)))*32,false)*stat.wav_vol/10*stat.wav_enable;
+					if (stems) st[2]=tmp;
+					if (b_enable[2]){
+						if (stat.ch_enable[2][0])
+							tmp_l+=tmp*stat.master_vol[0]/8;
+						if (stat.ch_enable[2][1])
+							tmp_r+=tmp*stat.master_vol[1]/8;
+					}
+				}
+				if ((b_enable[3]||stems)&&stat.noi_playing){
+					tmp=noi_produce(stat.noi_freq)*stat.noi_vol/20;
+					if (stems) st[3]=tmp;
+					if (b_enable[3]){
+						if (stat.ch_enable[3][0])
+							tmp_l+=tmp*stat.master_vol[0]/8;
+						if (stat.ch_enable[3][1])
+							tmp_r+=tmp*stat.master_vol[1]/8;
+					}
+				}
 			}
-			if (b_enable[2]&&stat.wav_playing/*&&(stat.wav_freq!=0x7ff)*/){
-				tmp=wav_produce((65536/(2048-(stat.wav_freq&0x7FF)))*32,false)*stat.wav_vol/10*stat.wav_enable;
-				if (stat.ch_enable[2][0])
-					tmp_l+=tmp*stat.master_vol[0]/8;
-				if (stat.ch_enable[2][1])
-					tmp_r+=tmp*stat.master_vol[1]/8;
+			if (stems){
+				for (int ch=0;ch<4;ch++){
+					tmp=st[ch];
+					tmp=(tmp>32767)?32767:tmp;
+					tmp=(tmp<-32767)?-32767:tmp;
+					stems[ch][i]=tmp;
+				}
 			}
-			if (b_enable[3]&&stat.noi_playing){
-				tmp=noi_produce(stat.noi_freq)*stat.noi_vol/20;
-				if (stat.ch_enable[3][0])
-					tmp_l+=tmp*stat.master_vol[0]/8;
-				if (stat.ch_enable[3][1])
-					tmp_r+=tmp*stat.master_vol[1]/8;
+			mix_l[j]=tmp_l;
+			mix_r[j]=tmp_r;
+
+			tmp_sample++;
+
+			while(update_count*CLOKS_PER_INTERVAL*(ref_apu->ref_gb->get_cpu()->get_speed()?2:1)<now_time-bef_clock){
+				update();
+				update_count++;
 			}
+//			if (tmp_sample>UPDATE_INTERVAL){
+//				tmp_sample-=UPDATE_INTERVAL;
+//				update();
+//			}
 		}
-		if (b_echo){
-			// エコー
-//			tmp_l/=2;
-//			tmp_r/=2;
-			int ttmp_l=tmp_l,ttmp_r=tmp_r;
-			ttmp_l*=5;ttmp_r*=5;
-			ttmp_l+=filter[counter*2]*2;
-			ttmp_r+=filter[counter*2+1]*2;
-			ttmp_l/=5;
-			ttmp_r/=5;
-			tmp_l=ttmp_l;
-			tmp_r=ttmp_r;
-			filter[counter*2]=tmp_l;
-			filter[counter*2+1]=tmp_r;
-			counter++;
-			if (counter>=2000)
-				counter=0;
-//			tmp_l/=2;
-//			tmp_r/=2;
-		}
-		if (b_lowpass){
-			// 出力をフィルタリング
-			bef_sample_l[4]=bef_sample_l[3];
-			bef_sample_l[3]=bef_sample_l[2];
-			bef_sample_l[2]=bef_sample_l[1];
-			bef_sample_l[1]=bef_sample_l[0];
-			bef_sample_l[0]=tmp_l;
-			bef_sample_r[4]=bef_sample_r[3];
-			bef_sample_r[3]=bef_sample_r[2];
-			bef_sample_r[2]=bef_sample_r[1];
-			bef_sample_r[1]=bef_sample_r[0];
-			bef_sample_r[0]=tmp_r;
-			tmp_l=(bef_sample_l[4]+bef_sample_l[3]*2+bef_sample_l[2]*8+bef_sample_l[1]*2+bef_sample_l[0])/14;
-			tmp_r=(bef_sample_r[4]+bef_sample_r[3]*2+bef_sample_r[2]*8+bef_sample_r[1]*2+bef_sample_r[0])/14;
-		}
-		tmp_l=(tmp_l>32767)?32767:tmp_l;
-		tmp_l=(tmp_l<-32767)?-32767:tmp_l;
-		tmp_r=(tmp_r>32767)?32767:tmp_r;
-		tmp_r=(tmp_r<-32767)?-32767:tmp_r;
-
-		//どうやらうちの3.5インチベイ内蔵スピーカが出力を逆にしていたみたい…
-//		buf[i*2]=tmp_l;
-//		buf[i*2+1]=tmp_r;
-		buf[i*2]=tmp_r;
-		buf[i*2+1]=tmp_l;
-
-		tmp_sample++;
-
-		while(update_count*CLOKS_PER_INTERVAL*(ref_apu->ref_gb->get_cpu()->get_speed()?2:1)<now_time-bef_clock){
-			update();
-			update_count++;
+
+		// 後処理 (apu_filter.cpp)
+		if (b_echo)
+			echo_filter(mix_l,mix_r,count);
+		if (b_lowpass)
+			lowpass_filter(mix_l,mix_r,count);
+
+		short *dat=buf+base*2;
+		for (int j=0;j<count;j++){
+			tmp_l=mix_l[j];
+			tmp_r=mix_r[j];
+			tmp_l=(tmp_l>32767)?32767:tmp_l;
+			tmp_l=(tmp_l<-32767)?-32767:tmp_l;
+			tmp_r=(tmp_r>32767)?32767:tmp_r;
+			tmp_r=(tmp_r<-32767)?-32767:tmp_r;
+
+			//どうやらうちの3.5インチベイ内蔵スピーカが出力を逆にしていたみたい…
+//			dat[j*2]=tmp_l;
+//			dat[j*2+1]=tmp_r;
+			dat[j*2]=tmp_r;
+			dat[j*2+1]=tmp_l;
 		}
-//		if (tmp_sample>UPDATE_INTERVAL){
-//			tmp_sample-=UPDATE_INTERVAL;
-//			update();
-//		}
 	}
 	while (cur<que_count){ // 取りこぼし
 		process(write_que[cur].adr,write_que[cur].dat);
@@ -693,3 +778,25 @@ void apu_snd::render(short *buf,int sample)
 	memcpy(&stat_cpy,&stat,sizeof(stat));
 	memcpy(&stat,&stat_tmp,sizeof(stat));
 }
+
+// 前回の render から進んだエミュレーション時間ぶんのサンプルを生成する
+// (ホスト側の要求量ではなくクロック数から決めるので、オフライン出力で長さがずれない)
+// max_sample を超える分は捨てる。戻り値は生成したサンプル数
+int apu_snd::render_pending(short *buf,int max_sample)
+{
+	int now_clock=ref_apu->ref_gb->get_cpu()->get_clock();
+	long long clocks_per_sec=(long long)CLOCKS_PER_SECOND*(ref_apu->ref_gb->get_cpu()->get_speed()?2:1);
+	long long total=(long long)(now_clock-bef_clock)*SAMPLE_RATE+pending_rest;
+
+	if (total<0) // リセット直後など
+		total=0;
+
+	int sample=(int)(total/clocks_per_sec);
+	pending_rest=(int)(total%clocks_per_sec);
+
+	if (sample>max_sample)
+		sample=max_sample;
+	if (sample>0)
+		render(buf,sample);
+	return sample;
+}
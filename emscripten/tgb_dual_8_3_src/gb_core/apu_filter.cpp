@@ -0,0 +1,165 @@
+/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// APU 後処理部 (エコー/ローパスフィルタ)
+//
+// どちらもミックス済みのサンプルをブロック (RENDER_BLOCK 以下) ごとにまとめて処理する。
+// 元の整数の割り算は単精度で行うが、途中の値は 2^24 未満で商が整数をまたいで丸まることもないので、
+// 切り捨てた結果は元のスカラー版 (SIMD が無い時に使う) と同じになる。
+
+#include "gb.h"
+#include <memory.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FILTER_SSE2
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define FILTER_WASM
+#endif
+
+#define ECHO_LENGTH 2000 // 遅延サンプル数
+
+// y=(5x+2h)/5, h=y (遅延 ECHO_LENGTH のフィードバック)
+// count は折り返しを含まないこと
+static void echo_block(int *buf,short *hist,int count)
+{
+	int i=0;
+#if defined(FILTER_SSE2)
+	const __m128 five=_mm_set1_ps(5.0f);
+	for (;i+4<=count;i+=4){
+		__m128i x=_mm_loadu_si128((__m128i*)(buf+i));
+		__m128i h=_mm_loadl_epi64((__m128i*)(hist+i));
+		h=_mm_srai_epi32(_mm_unpacklo_epi16(h,h),16);
+		__m128i v=_mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(x,2),x),_mm_slli_epi32(h,1));
+		__m128i y=_mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(v),five));
+		_mm_storeu_si128((__m128i*)(buf+i),y);
+		__m128i w=_mm_srai_epi32(_mm_slli_epi32(y,16),16); // short への代入と同じく下位16bitで切り捨て
+		_mm_storel_epi64((__m128i*)(hist+i),_mm_packs_epi32(w,w));
+	}
+#elif defined(FILTER_WASM)
+	const v128_t five=wasm_f32x4_splat(5.0f);
+	for (;i+4<=count;i+=4){
+		v128_t x=wasm_v128_load(buf+i);
+		v128_t h=wasm_i32x4_make(hist[i],hist[i+1],hist[i+2],hist[i+3]);
+		v128_t v=wasm_i32x4_add(wasm_i32x4_add(wasm_i32x4_shl(x,2),x),wasm_i32x4_shl(h,1));
+		v128_t y=wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_div(wasm_f32x4_convert_i32x4(v),five));
+		wasm_v128_store(buf+i,y);
+		v128_t w=wasm_i32x4_shr(wasm_i32x4_shl(y,16),16);
+		long long tmp=wasm_i64x2_extract_lane(wasm_i16x8_narrow_i32x4(w,w),0);
+		memcpy(hist+i,&tmp,8);
+	}
+#endif
+	for (;i<count;i++){
+		int tmp=buf[i]*5+hist[i]*2;
+		tmp/=5;
+		buf[i]=tmp;
+		hist[i]=tmp;
+	}
+}
+
+// y[n]=(x[n-4]+2x[n-3]+8x[n-2]+2x[n-1]+x[n])/14
+// count は RENDER_BLOCK 以下
+static void lowpass_block(int *buf,int *hist,int count)
+{
+	int ext[4+RENDER_BLOCK];
+	int *src=ext;
+	int i=0;
+
+	memcpy(ext,hist,4*sizeof(int));
+	memcpy(ext+4,buf,count*sizeof(int));
+
+#if defined(FILTER_SSE2)
+	const __m128 div=_mm_set1_ps(14.0f);
+	for (;i+4<=count;i+=4){
+		__m128i x0=_mm_loadu_si128((__m128i*)(src+i));
+		__m128i x1=_mm_loadu_si128((__m128i*)(src+i+1));
+		__m128i x2=_mm_loadu_si128((__m128i*)(src+i+2));
+		__m128i x3=_mm_loadu_si128((__m128i*)(src+i+3));
+		__m128i x4=_mm_loadu_si128((__m128i*)(src+i+4));
+		__m128i v=_mm_add_epi32(_mm_add_epi32(x0,x4),_mm_slli_epi32(_mm_add_epi32(x1,x3),1));
+		v=_mm_add_epi32(v,_mm_slli_epi32(x2,3));
+		_mm_storeu_si128((__m128i*)(buf+i),_mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(v),div)));
+	}
+#elif defined(FILTER_WASM)
+	const v128_t div=wasm_f32x4_splat(14.0f);
+	for (;i+4<=count;i+=4){
+		v128_t x0=wasm_v128_load(src+i);
+		v128_t x1=wasm_v128_load(src+i+1);
+		v128_t x2=wasm_v128_load(src+i+2);
+		v128_t x3=wasm_v128_load(src+i+3);
+		v128_t x4=wasm_v128_load(src+i+4);
+		v128_t v=wasm_i32x4_add(wasm_i32x4_add(x0,x4),wasm_i32x4_shl(wasm_i32x4_add(x1,x3),1));
+		v=wasm_i32x4_add(v,wasm_i32x4_shl(x2,3));
+		wasm_v128_store(buf+i,wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_div(wasm_f32x4_convert_i32x4(v),div)));
+	}
+#endif
+	for (;i<count;i++)
+		buf[i]=(src[i]+src[i+1]*2+src[i+2]*8+src[i+3]*2+src[i+4])/14;
+
+	memcpy(hist,ext+count,4*sizeof(int));
+}
+
+void apu_snd::echo_filter(int *buf_l,int *buf_r,int count)
+{
+	int done=0;
+	while (done<count){
+		int len=ECHO_LENGTH-echo_pos;
+		if (len>count-done)
+			len=count-done;
+		echo_block(buf_l+done,echo_buf[0]+echo_pos,len);
+		echo_block(buf_r+done,echo_buf[1]+echo_pos,len);
+		echo_pos+=len;
+		if (echo_pos>=ECHO_LENGTH)
+			echo_pos=0;
+		done+=len;
+	}
+}
+
+void apu_snd::lowpass_filter(int *buf_l,int *buf_r,int count)
+{
+	for (int done=0;done<count;done+=RENDER_BLOCK){
+		int len=(count-done<RENDER_BLOCK)?(count-done):RENDER_BLOCK;
+		lowpass_block(buf_l+done,lowpass_buf[0],len);
+		lowpass_block(buf_r+done,lowpass_buf[1],len);
+	}
+}
+
+// フィルタの履歴 (ステートに含めないと復元直後の音がずれる)
+int apu_snd::get_filter_size()
+{
+	return sizeof(int)+sizeof(echo_buf)+sizeof(lowpass_buf);
+}
+
+void apu_snd::save_filter(state_io *io)
+{
+	io->write(&echo_pos,sizeof(int));
+	io->write(echo_buf,sizeof(echo_buf));
+	io->write(lowpass_buf,sizeof(lowpass_buf));
+}
+
+void apu_snd::restore_filter(state_io *io)
+{
+	io->read(&echo_pos,sizeof(int));
+	io->read(echo_buf,sizeof(echo_buf));
+	io->read(lowpass_buf,sizeof(lowpass_buf));
+	if (echo_pos<0||echo_pos>=ECHO_LENGTH)
+		echo_pos=0;
+}
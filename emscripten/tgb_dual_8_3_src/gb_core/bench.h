@@ -0,0 +1,68 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ベンチマーク用の区間計測 (TGB_BENCH を定義してビルドした時だけ)
+//
+// BENCH_SCOPE(id) を置いたブロックの時間を bench_ticks[id] に足していく。
+// bench_enable が false の間は計らない (同じビルドで計測なしの速度も測れるように)。
+// 値はスレッドごと。x86 では rdtsc の値なので、秒にするのは呼び出し側で行う。
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#define BENCH_CPU 0 // cpu::exec
+#define BENCH_LCD 1 // lcd::render
+#define BENCH_SOUND 2 // apu_snd::render
+#define BENCH_SCREEN 3 // web_renderer::render_screen
+#define BENCH_STATE 4 // ステートの保存と復元 (呼び出し側で計る)
+#define BENCH_COUNT 5
+
+#ifdef TGB_BENCH
+
+#include "gb_types.h"
+
+#if defined(__x86_64__)||defined(__i386__)
+#include <x86intrin.h>
+inline unsigned long long bench_now() { return __rdtsc(); }
+#else
+#include <chrono>
+inline unsigned long long bench_now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+#endif
+
+extern thread_local bool bench_enable;
+extern thread_local unsigned long long bench_ticks[BENCH_COUNT];
+
+struct bench_scope{
+	int id;
+	unsigned long long start;
+
+	bench_scope(int num) { id=num; start=bench_enable?bench_now():0; }
+	~bench_scope() { if (start) bench_ticks[id]+=bench_now()-start; }
+};
+
+#define BENCH_SCOPE(id) bench_scope bench_scope_(id)
+
+#else
+
+#define BENCH_SCOPE(id)
+
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 実行中の回数の計測 (TGB_COUNTERS を定義してビルドした時だけ数える)
+//
+// gb ごとに 1 つ持ち、gb::get_counters() で読める (JS からは tgbGetCounters)。
+// 値は clear_counters() からの累計で、dword なので長く動かすと一周する。
+// 毎フレーム読んで前回との差を取る使い方を想定している。
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include "gb_types.h"
+
+// メモリの領域
+#define COUNTER_ROM0 0 // 0000-3FFF
+#define COUNTER_ROMX 1 // 4000-7FFF
+#define COUNTER_VRAM 2 // 8000-9FFF
+#define COUNTER_SRAM 3 // A000-BFFF (MBC のレジスタやタイマーも)
+#define COUNTER_WRAM 4 // C000-FDFF (エコーも)
+#define COUNTER_OAM 5 // FE00-FEFF
+#define COUNTER_IO 6 // FF00-FF7F, FFFF
+#define COUNTER_HRAM 7 // FF80-FFFE
+#define COUNTER_REGIONS 8
+
+// 割り込みの種類 (IF のビット順)
+#define COUNTER_INT_VBLANK 0
+#define COUNTER_INT_LCDC 1
+#define COUNTER_INT_TIMER 2
+#define COUNTER_INT_SERIAL 3
+#define COUNTER_INT_PAD 4
+#define COUNTER_INTS 5
+
+struct gb_counters{
+	dword instructions; // 実行した命令 (CB xx は 1 つ)
+	dword opcodes[256]; // 命令ごと
+	dword opcodes_cb[256]; // CB xx の xx ごと
+	dword reads[COUNTER_REGIONS]; // CPU からの読み込み (命令の読み込みも含む)
+	dword writes[COUNTER_REGIONS]; // CPU からの書き込み
+	dword rom_bank_switches; // MBC で ROM バンクが変わった回数
+	dword ram_bank_switches; // MBC で SRAM バンクが変わった回数
+	dword hdma_bytes; // HDMA/GDMA で VRAM へ送ったバイト数
+	dword apu_writes; // サウンドレジスタ (FF10-FF3F) への書き込み
+	dword interrupts[COUNTER_INTS]; // 受け付けた割り込み
+	dword lines_rendered; // 描画したライン
+	dword lines_skipped; // フレームスキップや set_lcd_enable(false) で描かなかったライン
+};
+
+inline int counter_region(word adr)
+{
+	static const byte regions[16]={
+		COUNTER_ROM0,COUNTER_ROM0,COUNTER_ROM0,COUNTER_ROM0,
+		COUNTER_ROMX,COUNTER_ROMX,COUNTER_ROMX,COUNTER_ROMX,
+		COUNTER_VRAM,COUNTER_VRAM,COUNTER_SRAM,COUNTER_SRAM,
+		COUNTER_WRAM,COUNTER_WRAM,COUNTER_WRAM,COUNTER_WRAM,
+	};
+	if (adr<0xFE00)
+		return regions[adr>>12];
+	else if (adr<0xFF00)
+		return COUNTER_OAM;
+	else if (adr<0xFF80||adr==0xFFFF)
+		return COUNTER_IO;
+	return COUNTER_HRAM;
+}
+
+#ifdef TGB_COUNTERS
+#define COUNTER(expr) (expr)
+#else
+#define COUNTER(expr)
+#endif
+
+#endif
@@ -21,6 +21,10 @@
 // CPU ニーモニック以外実装部 (I/O､IRQ 等)
 
 #include "gb.h" 
+#include "bench.h"
+#include "profiler.h"
+#include "trace.h"
+#include "debugger.h"
 #include <memory.h>
 #include <string.h>
 
@@ -29,12 +33,18 @@
 #define N_FLAG 0x02
 #define C_FLAG 0x01
 
-FILE *file;
+//FILE *file; // デバッグ用のログ (下のコメントアウトした fprintf 用)
+
+#ifdef TGB_BENCH
+thread_local bool bench_enable=false;
+thread_local unsigned long long bench_ticks[BENCH_COUNT];
+#endif
 
 cpu::cpu(gb *ref)
 {
 	ref_gb=ref;
 	b_trace=false;
+	trace=NULL;
 
 	for (int i=0;i<256;i++){
 		z802gb[i]=((i&0x40)?0x80:0)|((i&0x10)?0x20:0)|((i&0x02)?0x40:0)|((i&0x01)?0x10:0);
@@ -49,10 +59,71 @@ cpu::cpu(gb *ref)
 cpu::~cpu()
 {
 //	fclose(file);
+	delete trace;
+}
+
+void cpu::set_trace(bool enable)
+{
+	if (enable&&!trace)
+		trace=new trace_ring(TRACE_DEFAULT_RECORDS);
+	b_trace=enable;
+}
+
+void cpu::set_trace_size(int records)
+{
+	delete trace;
+	trace=new trace_ring(records);
+}
+
+void cpu::debug_access(int type,word adr,byte dat)
+{
+	debugger *dbg=ref_gb->m_dbg;
+	word pc=debug_regs.PC;
+	int bank=(pc>=0x4000&&pc<0x8000)?rom_bank():0;
+	int id=dbg->find(type,adr,bank);
+	if (id<0)
+		return;
+
+	break_hit hit;
+	hit.id=id;
+	hit.type=type;
+	hit.pc=pc;
+	hit.bank=bank;
+	hit.adr=adr;
+	hit.dat=dat;
+	hit.line=ref_gb->get_regs()->LY;
+	hit.clock=total_clock;
+	hit.af=(debug_regs.AF.b.h<<8)|z802gb[debug_regs.AF.b.l];
+	hit.bc=debug_regs.BC.w;
+	hit.de=debug_regs.DE.w;
+	hit.hl=debug_regs.HL.w;
+	hit.sp=debug_regs.SP;
+	hit.count=0;
+	dbg->hit(hit);
+}
+
+void cpu::log()
+{
+	trace_record *rec=trace->next();
+	word pc=regs.PC;
+	rec->pc=pc;
+	rec->bank=(pc>=0x4000&&pc<0x8000)?rom_bank():0;
+	for (int i=0;i<3;i++){
+		word adr=pc+i;
+		rec->op[i]=(adr<0xFE00||(adr>=0xFF80&&adr<0xFFFF))?read_direct(adr):0; // I/O は読むと副作用があるので見ない
+	}
+	rec->flags=(regs.I?TRACE_IME:0)|(speed?TRACE_SPEED:0);
+	rec->af=(regs.AF.b.h<<8)|z802gb[regs.AF.b.l];
+	rec->bc=regs.BC.w;
+	rec->de=regs.DE.w;
+	rec->hl=regs.HL.w;
+	rec->sp=regs.SP;
+	rec->clock=total_clock;
 }
 
 void cpu::reset()
 {
+	memset(&regs,0,sizeof(regs)); // 詰め物もステートに入るので
 	regs.AF.w=(ref_gb->get_rom()->get_info()->gb_type>=3)?0x11b0:0x01b0;
 	regs.BC.w=(ref_gb->get_rom()->get_info()->gb_type>=4)?0x0113:0x0013;
 	regs.DE.w=0x00D8;
@@ -67,12 +138,15 @@ void cpu::reset()
 	rest_clock=0;
 	total_clock=sys_clock=div_clock=0;
 	seri_occer=0x7fffffff;
+	seri_pending=false;
 	halt=false;
 	speed=false;
 	speed_change=false;
 	dma_executing=false;
 	b_dma_first=false;
 	gdma_rest=0;
+	dma_src=dma_dest=dma_rest=0;
+	_ff6c=_ff72=_ff73=_ff74=_ff75=0;
 
 	last_int=0;
 	int_desable=false;
@@ -82,6 +156,7 @@ void cpu::reset()
 	memset(stack,0,sizeof(stack));
 	memset(oam,0,sizeof(oam));
 	memset(spare_oam,0,sizeof(spare_oam));
+	memset(ext_mem,0,sizeof(ext_mem));
 
 	rp_que[0]=0x000001cc;
 	rp_que[1]=0x00000000;
@@ -107,12 +182,19 @@ void cpu::save_state_ex(int *dat)
 	dat[1]=rest_clock;
 	dat[2]=sys_clock;
 	dat[3]=total_clock;
+	dat[4]=seri_occer;
+	dat[5]=gdma_rest;
+	dat[6]=(b_dma_first?1:0);
+	dat[7]=last_int;
+	dat[8]=(int_desable?1:0);
+	dat[9]=(int)(_ff6c|(_ff72<<8)|(_ff73<<16)|((unsigned int)_ff74<<24));
+	dat[10]=_ff75;
 }
 
 void cpu::restore_state(int *dat)
 {
-	ram_bank=ram+dat[0]*0x1000;
-	vram_bank=vram+dat[1]*0x2000;
+	ram_bank=ram+(dat[0]&7)*0x1000;
+	vram_bank=vram+(dat[1]&1)*0x2000;
 
 	speed=(dat[2]?true:false);
 	dma_executing=(dat[3]?true:false);
@@ -128,9 +210,70 @@ void cpu::restore_state_ex(int *dat)
 	rest_clock=dat[1];
 	sys_clock=dat[2];
 	total_clock=dat[3];
+	seri_occer=dat[4];
+	seri_pending=false;
+	gdma_rest=dat[5];
+	b_dma_first=(dat[6]?true:false);
+	last_int=dat[7];
+	int_desable=(dat[8]?true:false);
+	_ff6c=dat[9]&0xff;
+	_ff72=(dat[9]>>8)&0xff;
+	_ff73=(dat[9]>>16)&0xff;
+	_ff74=(dat[9]>>24)&0xff;
+	_ff75=dat[10]&0xff;
 }
 
-inline byte cpu::read_direct(word adr)
+// HBlank DMA の転送元/先はポインタで持っているので、ステートには番号で入れる
+// dat[0] 転送元 (0:まだ決まっていない 1:ROM 2:SRAM 3:WRAM)
+// dat[1] 転送元のページ (ROM は 0x4000、SRAM は 0x2000、WRAM は 0x1000 単位)
+// dat[2] 転送先の VRAM バンク
+void cpu::get_hdma_bank(int *dat)
+{
+	dat[0]=dat[1]=dat[2]=0;
+	if (!dma_executing||b_dma_first||!dma_src_bank)
+		return;
+
+	intptr_t src=(intptr_t)dma_src_bank;
+	intptr_t rom_base=(intptr_t)ref_gb->get_rom()->get_rom();
+	intptr_t sram_base=(intptr_t)ref_gb->get_rom()->get_sram()-0xA000;
+	intptr_t wram_base=(intptr_t)ram-0xC000;
+
+	if (src>=wram_base&&src<=wram_base+0x6000){
+		dat[0]=3;
+		dat[1]=(int)((src-wram_base)/0x1000);
+	}
+	else if (src>=sram_base&&src<sram_base+ref_gb->get_rom()->get_sram_size()){
+		dat[0]=2;
+		dat[1]=(int)((src-sram_base)/0x2000);
+	}
+	else{
+		dat[0]=1;
+		dat[1]=(int)((src-rom_base)/0x4000);
+	}
+	dat[2]=(int)((dma_dest_bank-vram)/0x2000);
+}
+
+// 決まっていない (古いステート) か範囲外の時は、次の HBlank で今のバンクから決め直す
+void cpu::set_hdma_bank(int *dat)
+{
+	int page=dat[1];
+	rom *r=ref_gb->get_rom();
+
+	dma_src_bank=NULL;
+	dma_dest_bank=vram+(dat[2]&1)*0x2000;
+	if (dat[0]==1&&r->get_first()+page+1>=0&&(long long)(r->get_first()+page+2)*0x4000<=r->get_image_size())
+		dma_src_bank=r->get_rom()+page*0x4000;
+	else if (dat[0]==2&&page>=0&&(page+1)*0x2000<=r->get_sram_size())
+		dma_src_bank=r->get_sram()+page*0x2000-0xA000;
+	else if (dat[0]==3&&page>=0&&page<=6)
+		dma_src_bank=ram+page*0x1000-0xC000;
+
+	if (dma_executing&&!dma_src_bank)
+		b_dma_first=true;
+}
+
+// cheat.cpp からも呼ぶので inline にはしない
+byte cpu::read_direct(word adr)
 {
 	switch(adr>>13){
 	case 0:
@@ -161,7 +304,7 @@ inline byte cpu::read_direct(word adr)
 		else if (adr<0xFEA0)
 			return oam[adr-0xFE00];//object attribute memory
 		else if (adr<0xFF00)
-			return spare_oam[(((adr-0xFFA0)>>5)<<3)|(adr&7)];
+			return spare_oam[(((adr-0xFEA0)>>5)<<3)|(adr&7)];
 		else if (adr<0xFF80)
 			return io_read(adr);//I/O
 		else if (adr<0xFFFF)
@@ -174,19 +317,35 @@ inline byte cpu::read_direct(word adr)
 
 void cpu::write(word adr,byte dat)
 {
+	COUNTER(ref_gb->counters.writes[counter_region(adr)]++);
+
 	switch(adr>>13){
 	case 0:
 	case 1:
 	case 2:
 	case 3:
+#ifdef TGB_COUNTERS
+		{
+			byte *bef_rom=ref_gb->get_mbc()->get_rom(),*bef_sram=ref_gb->get_mbc()->get_sram();
+			ref_gb->get_mbc()->write(adr,dat);
+			if (ref_gb->get_mbc()->get_rom()!=bef_rom)
+				ref_gb->counters.rom_bank_switches++;
+			if (ref_gb->get_mbc()->get_sram()!=bef_sram)
+				ref_gb->counters.ram_bank_switches++;
+		}
+#else
 		ref_gb->get_mbc()->write(adr,dat);
+#endif
 		break;
 	case 4:
 		vram_bank[adr&0x1FFF]=dat;
 		break;
 	case 5:
-		if (ref_gb->get_mbc()->is_ext_ram())
+		if (ref_gb->get_mbc()->is_ext_ram()){
+			if (ref_gb->get_rom()->is_sram_shared())
+				ref_gb->unshare_sram();
 			ref_gb->get_mbc()->get_sram()[adr&0x1FFF]=dat;//カートリッジRAM
+		}
 		else
 			ref_gb->get_mbc()->ext_write(adr,dat);
 		break;
@@ -206,7 +365,7 @@ void cpu::write(word adr,byte dat)
 		else if (adr<0xFEA0)
 			oam[adr-0xFE00]=dat;
 		else if (adr<0xFF00)
-			spare_oam[(((adr-0xFFA0)>>5)<<3)|(adr&7)]=dat;
+			spare_oam[(((adr-0xFEA0)>>5)<<3)|(adr&7)]=dat;
 		else if (adr<0xFF80)
 			io_write(adr,dat);//I/O
 		else if (adr<0xFFFF)
@@ -603,6 +762,7 @@ void cpu::io_write(word adr,byte dat)
 				}
 				dma_src+=((dat&0x7F)+1)*16;
 				dma_dest+=((dat&0x7F)+1)*16;
+				COUNTER(ref_gb->counters.hdma_bytes+=((dat&0x7F)+1)*16);
 
 				gdma_rest=456*2+((dat&0x7f)+1)*32*(speed?2:1); // CPU パワーを占領
 			}
@@ -851,6 +1011,15 @@ byte cpu::seri_send(byte dat)
 		return 0xFF;
 }
 
+// link_cable が交換した結果を受け取る (送信側)
+void cpu::seri_done(byte dat)
+{
+	ref_gb->get_regs()->SB=dat;
+	ref_gb->get_regs()->SC&=3;
+	seri_pending=false;
+	irq(INT_SERIAL);
+}
+
 void cpu::irq(int irq_type)
 {
 //	fprintf(file,"irq %02X LCDC %02X\n",irq_type,ref_gb->get_regs()->LCDC);
@@ -876,26 +1045,31 @@ void cpu::irq_process()
 			regs.PC=0x40;
 			ref_gb->get_regs()->IF&=0xFE;
 			last_int=INT_VBLANK;
+			COUNTER(ref_gb->counters.interrupts[COUNTER_INT_VBLANK]++);
 		}
 		else if (ref_gb->get_regs()->IF&ref_gb->get_regs()->IE&INT_LCDC){//LCDC
 			regs.PC=0x48;
 			ref_gb->get_regs()->IF&=0xFD;
 			last_int=INT_LCDC;
+			COUNTER(ref_gb->counters.interrupts[COUNTER_INT_LCDC]++);
 		}
 		else if (ref_gb->get_regs()->IF&ref_gb->get_regs()->IE&INT_TIMER){//Timer
 			regs.PC=0x50;
 			ref_gb->get_regs()->IF&=0xFB;
 			last_int=INT_TIMER;
+			COUNTER(ref_gb->counters.interrupts[COUNTER_INT_TIMER]++);
 		}
 		else if (ref_gb->get_regs()->IF&ref_gb->get_regs()->IE&INT_SERIAL){//Serial
 			regs.PC=0x58;
 			ref_gb->get_regs()->IF&=0xF7;
 			last_int=INT_SERIAL;
+			COUNTER(ref_gb->counters.interrupts[COUNTER_INT_SERIAL]++);
 		}
 		else if (ref_gb->get_regs()->IF&ref_gb->get_regs()->IE&INT_PAD){//Pad
 			regs.PC=0x60;
 			ref_gb->get_regs()->IF&=0xEF;
 			last_int=INT_PAD;
+			COUNTER(ref_gb->counters.interrupts[COUNTER_INT_PAD]++);
 		}
 		else {}
 
@@ -907,6 +1081,8 @@ void cpu::irq_process()
 
 void cpu::exec(int clocks)
 {
+	BENCH_SCOPE(BENCH_CPU);
+
 	if (speed)
 		clocks*=2;
 
@@ -914,12 +1090,6 @@ void cpu::exec(int clocks)
 	rp_que[1]=0x00000000;
 	que_cur=1;
 
-	int op_code;
-	int tmp_clocks;
-	byte tmpb;
-	pare_reg tmp;
-	static const int timer_clocks[]={1024,16,64,256};
-
 	rest_clock+=clocks;
 
 	if (gdma_rest){
@@ -939,14 +1109,56 @@ void cpu::exec(int clocks)
 		}
 	}
 
+	if (ref_gb->m_dbg->is_active())
+		exec_loop<true>();
+	else
+		exec_loop<false>();
+}
+
+template<bool CHECK>
+void cpu::exec_loop()
+{
+	int op_code;
+	int tmp_clocks;
+	byte tmpb;
+	pare_reg tmp;
+	static const int timer_clocks[]={1024,16,64,256};
+
+	// 命令の中の読み書き (op_normal.h, op_cb.h) はここを通る
+	// CHECK が false なら普通の read/write と同じになる
+	auto read=[this](word adr)->byte{
+		byte dat=this->read(adr);
+		if (CHECK&&ref_gb->m_dbg->check_access(adr,BREAK_READ))
+			debug_access(BREAK_READ,adr,dat);
+		return dat;
+	};
+	auto write=[this](word adr,byte dat){
+		if (CHECK&&ref_gb->m_dbg->check_access(adr,BREAK_WRITE))
+			debug_access(BREAK_WRITE,adr,dat);
+		this->write(adr,dat);
+	};
+	auto readw=[&](word adr)->word{ return read(adr)|(read(adr+1)<<8); };
+	auto writew=[&](word adr,word dat){ write(adr,(byte)dat);write(adr+1,dat>>8); };
+
 	while(rest_clock>0){
 		irq_process();
 
+		if (CHECK){
+			debug_regs=regs;
+			if (!halt&&ref_gb->m_dbg->check_exec(regs.PC))
+				debug_access(BREAK_EXEC,regs.PC,0);
+		}
+
+#ifdef TGB_PROFILE
+		word prof_pc=regs.PC;
+#endif
+		if (b_trace&&!halt) // HALT 中の空回りは積まない
+			log();
+
 		op_code=op_read();
 		tmp_clocks=cycles[op_code];
-
-//		if (b_trace)
-//			log();
+		COUNTER(ref_gb->counters.instructions++);
+		COUNTER(ref_gb->counters.opcodes[op_code]++);
 
 		switch(op_code)
 		{
@@ -954,6 +1166,7 @@ void cpu::exec(int clocks)
 		case 0xCB:
 			op_code=op_read();
 			tmp_clocks=cycles_cb[op_code];
+			COUNTER(ref_gb->counters.opcodes_cb[op_code]++);
 			switch(op_code){
 #include "op_cb.h"
 			}
@@ -964,6 +1177,12 @@ void cpu::exec(int clocks)
 		div_clock+=tmp_clocks;
 		total_clock+=tmp_clocks;
 
+#ifdef TGB_PROFILE
+		if (ref_gb->m_prof&&ref_gb->m_prof->tick(tmp_clocks)){
+			ref_gb->m_prof->sample(prof_pc,(prof_pc>=0x4000&&prof_pc<0x8000)?rom_bank():0);
+		}
+#endif
+
 		if (ref_gb->get_regs()->TAC&0x04){//タイマ割りこみ
 			sys_clock+=tmp_clocks;
 			if (sys_clock>timer_clocks[ref_gb->get_regs()->TAC&0x03]){
@@ -983,7 +1202,9 @@ void cpu::exec(int clocks)
 
 		if (total_clock>seri_occer){
 			seri_occer=0x7fffffff;
-			if (ref_gb->get_target()){
+			if (ref_gb->get_link()) // 相手は別スレッドで動いているので、区切りで link_cable が交換する
+				seri_pending=true;
+			else if (ref_gb->get_target()){
 				byte ret=ref_gb->get_target()->get_cpu()->seri_send(ref_gb->get_regs()->SB);
 				ref_gb->get_regs()->SB=ret;
 				ref_gb->get_regs()->SC&=3;
@@ -999,7 +1220,8 @@ void cpu::exec(int clocks)
 					ref_gb->get_regs()->SC&=3;
 				}
 			}
-			irq(INT_SERIAL);
+			if (!seri_pending)
+				irq(INT_SERIAL);
 		}
 	}
 }
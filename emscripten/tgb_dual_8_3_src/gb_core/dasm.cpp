@@ -0,0 +1,116 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 逆アセンブラ (トレースの表示用)
+//
+// 表の中の記号 : # 即値 8bit、@ 即値 16bit、~ 相対ジャンプ先、% 符号付き 8bit、^ $FF00+即値
+
+#include "gb.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *op_names[256]={
+	"NOP","LD BC,@","LD (BC),A","INC BC","INC B","DEC B","LD B,#","RLCA",
+	"LD (@),SP","ADD HL,BC","LD A,(BC)","DEC BC","INC C","DEC C","LD C,#","RRCA",
+	"STOP","LD DE,@","LD (DE),A","INC DE","INC D","DEC D","LD D,#","RLA",
+	"JR ~","ADD HL,DE","LD A,(DE)","DEC DE","INC E","DEC E","LD E,#","RRA",
+	"JR NZ,~","LD HL,@","LD (HL+),A","INC HL","INC H","DEC H","LD H,#","DAA",
+	"JR Z,~","ADD HL,HL","LD A,(HL+)","DEC HL","INC L","DEC L","LD L,#","CPL",
+	"JR NC,~","LD SP,@","LD (HL-),A","INC SP","INC (HL)","DEC (HL)","LD (HL),#","SCF",
+	"JR C,~","ADD HL,SP","LD A,(HL-)","DEC SP","INC A","DEC A","LD A,#","CCF",
+	NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL, // 40-7F は LD r,r'
+	NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
+	NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
+	NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
+	NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL, // 80-BF は演算
+	NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
+	NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
+	NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
+	"RET NZ","POP BC","JP NZ,@","JP @","CALL NZ,@","PUSH BC","ADD A,#","RST $00",
+	"RET Z","RET","JP Z,@",NULL,"CALL Z,@","CALL @","ADC A,#","RST $08",
+	"RET NC","POP DE","JP NC,@","DB $D3","CALL NC,@","PUSH DE","SUB #","RST $10",
+	"RET C","RETI","JP C,@","DB $DB","CALL C,@","DB $DD","SBC A,#","RST $18",
+	"LD (^),A","POP HL","LD ($FF00+C),A","DB $E3","DB $E4","PUSH HL","AND #","RST $20",
+	"ADD SP,%","JP (HL)","LD (@),A","DB $EB","DB $EC","DB $ED","XOR #","RST $28",
+	"LD A,(^)","POP AF","LD A,($FF00+C)","DI","DB $F4","PUSH AF","OR #","RST $30",
+	"LD HL,SP%","LD SP,HL","LD A,(@)","EI","DB $FC","DB $FD","CP #","RST $38",
+};
+
+static const char *reg_names[8]={"B","C","D","E","H","L","(HL)","A"};
+static const char *alu_names[8]={"ADD A,","ADC A,","SUB ","SBC A,","AND ","XOR ","OR ","CP "};
+static const char *rot_names[8]={"RLC","RRC","RL","RR","SLA","SRA","SWAP","SRL"};
+
+// A の命令を S に書いて命令のバイト数を返す。pc は相対ジャンプ先の計算用
+int cpu::dasm(char *S,const byte *A,word pc)
+{
+	byte op=A[0];
+
+	if (op==0xCB){
+		byte cb=A[1];
+		if (cb<0x40)
+			sprintf(S,"%s %s",rot_names[cb>>3],reg_names[cb&7]);
+		else
+			sprintf(S,"%s %d,%s",(cb<0x80)?"BIT":(cb<0xC0)?"RES":"SET",(cb>>3)&7,reg_names[cb&7]);
+		return 2;
+	}
+	if (op==0x76){
+		strcpy(S,"HALT");
+		return 1;
+	}
+	if (op>=0x40&&op<0x80){
+		sprintf(S,"LD %s,%s",reg_names[(op>>3)&7],reg_names[op&7]);
+		return 1;
+	}
+	if (op>=0x80&&op<0xC0){
+		sprintf(S,"%s%s",alu_names[(op>>3)&7],reg_names[op&7]);
+		return 1;
+	}
+
+	int len=(op==0x10)?2:1; // STOP は 2 バイト
+	for (const char *p=op_names[op];*p;p++){
+		switch(*p){
+		case '#':
+			S+=sprintf(S,"$%02X",A[1]);
+			len=2;
+			break;
+		case '^':
+			S+=sprintf(S,"$FF%02X",A[1]);
+			len=2;
+			break;
+		case '%':
+			S+=sprintf(S,"%c$%02X",((signed char)A[1]<0)?'-':'+',((signed char)A[1]<0)?-(signed char)A[1]:A[1]);
+			len=2;
+			break;
+		case '~':
+			S+=sprintf(S,"$%04X",(word)(pc+2+(signed char)A[1]));
+			len=2;
+			break;
+		case '@':
+			S+=sprintf(S,"$%04X",A[1]|(A[2]<<8));
+			len=3;
+			break;
+		default:
+			*(S++)=*p;
+			break;
+		}
+	}
+	*S='\0';
+	return len;
+}
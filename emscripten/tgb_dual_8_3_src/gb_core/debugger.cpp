@@ -0,0 +1,111 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ブレークポイントとウォッチポイント
+
+#include "debugger.h"
+#include <string.h>
+
+debugger::debugger()
+{
+	next_id=1;
+	b_hit=false;
+	b_suspend=false;
+	memset(&last,0,sizeof(last));
+	rebuild();
+}
+
+debugger::~debugger()
+{
+}
+
+int debugger::add_break(word pc,int bank)
+{
+	point p={next_id++,BREAK_EXEC,pc,pc,bank};
+	points.push_back(p);
+	rebuild();
+	return p.id;
+}
+
+int debugger::add_watch(word start,word end,int type)
+{
+	type&=BREAK_READ|BREAK_WRITE;
+	if (!type||start>end)
+		return -1;
+	point p={next_id++,type,start,end,BREAK_ANY_BANK};
+	points.push_back(p);
+	rebuild();
+	return p.id;
+}
+
+bool debugger::remove(int id)
+{
+	for (size_t i=0;i<points.size();i++){
+		if (points[i].id==id){
+			points.erase(points.begin()+i);
+			rebuild();
+			return true;
+		}
+	}
+	return false;
+}
+
+void debugger::clear()
+{
+	points.clear();
+	rebuild();
+	resume();
+}
+
+// 速く調べるための表を作り直す
+void debugger::rebuild()
+{
+	memset(exec_map,0,sizeof(exec_map));
+	memset(page_map,0,sizeof(page_map));
+	for (size_t i=0;i<points.size();i++){
+		const point &p=points[i];
+		if (p.type==BREAK_EXEC)
+			exec_map[p.start>>3]|=1<<(p.start&7);
+		else{
+			for (int page=p.start>>8;page<=(p.end>>8);page++)
+				page_map[page]|=p.type;
+		}
+	}
+}
+
+int debugger::find(int type,word adr,int bank)
+{
+	for (size_t i=0;i<points.size();i++){
+		const point &p=points[i];
+		if ((p.type&type)&&adr>=p.start&&adr<=p.end&&(p.bank==BREAK_ANY_BANK||p.bank==bank))
+			return p.id;
+	}
+	return -1;
+}
+
+void debugger::hit(const break_hit &dat)
+{
+	int count=last.count+1;
+	if (!b_hit){
+		last=dat;
+		b_hit=true;
+	}
+	last.count=count;
+}
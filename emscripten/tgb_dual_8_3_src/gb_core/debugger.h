@@ -0,0 +1,101 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ブレークポイントとウォッチポイント
+//
+// 1 つでも設定されている間だけ、cpu::exec が調べる版のループ (exec_loop<true>) に切り替わる。
+// 何も無ければ exec の頭で 1 回見るだけなので、普段の速度は変わらない。
+//
+// 当たってもその場では止めない (タイミングが変わらないように命令は続ける)。
+// 最初に当たった所を break_hit に残し、runFrames がそのフレームの終わりで止まる。
+// resume() するまで次の break_hit は残らない (count だけ増える)。
+// ウォッチは CPU 命令からの読み書きだけで、命令の読み込みと割り込みの push は含まない。
+
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "gb_types.h"
+
+#define BREAK_EXEC 1 // PC が来た
+#define BREAK_READ 2 // 範囲を読んだ
+#define BREAK_WRITE 4 // 範囲に書いた
+
+#define BREAK_ANY_BANK -1
+
+// JS から HEAP32 で読むので全部 int
+struct break_hit{
+	int id; // add_break / add_watch の戻り値
+	int type; // BREAK_*
+	int pc; // 当たった命令
+	int bank; // PC が 4000-7FFF の時の ROM バンク
+	int adr; // ウォッチの時のアドレス
+	int dat; // 読んだ値、書いた値
+	int line; // LY
+	int clock; // cpu::get_clock()
+	int af,bc,de,hl,sp; // 命令の前のレジスタ (F は GB の形式)
+	int count; // resume から当たった回数
+};
+
+class debugger
+{
+public:
+	debugger();
+	~debugger();
+
+	int add_break(word pc,int bank); // bank が BREAK_ANY_BANK ならどのバンクでも。戻り値は id
+	int add_watch(word start,word end,int type); // start-end (両端を含む) を BREAK_READ|BREAK_WRITE で見る
+	bool remove(int id);
+	void clear();
+	bool is_active() { return !b_suspend&&!points.empty(); }
+	void set_suspend(bool suspend) { b_suspend=suspend; } // 後で巻き戻す区間 (先行実行) では調べない
+
+	bool check_exec(word pc) { return (exec_map[pc>>3]>>(pc&7))&1; } // 当たるかもしれない時 true
+	bool check_access(word adr,int type) { return (page_map[adr>>8]&type)!=0; }
+	int find(int type,word adr,int bank); // 当たった id (無ければ -1)
+
+	void hit(const break_hit &dat);
+	break_hit *get_hit() { return b_hit?&last:NULL; }
+	void resume() { b_hit=false;last.count=0; }
+
+private:
+	struct point{
+		int id;
+		int type;
+		word start,end;
+		int bank;
+	};
+
+	void rebuild();
+
+	std::vector<point> points;
+	int next_id;
+
+	byte exec_map[0x10000/8]; // ブレークポイントのある PC
+	byte page_map[0x100]; // ウォッチのある 256 バイトごとの BREAK_READ|BREAK_WRITE
+
+	bool b_hit;
+	break_hit last;
+	bool b_suspend;
+};
+
+#endif
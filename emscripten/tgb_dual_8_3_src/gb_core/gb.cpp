@@ -21,12 +21,41 @@
 // GB その他エミュレーション部/外部とのインターフェース
 #define _CRT_SECURE_NO_WARNINGS
 #include "gb.h"
+#include "lz.h"
+#include "profiler.h"
+#include "debugger.h"
 //#include <stdlib.h>
 #include <memory.h>
+#include <vector>
+
+#define STATE_EX_MAGIC 0x31584554 // "TEX1"
+
+// ステートセーブの形式
+// "TGBS" , バージョン , [chunk ID (4文字) , 長さ , 中身]... , "END "
+// 知らない chunk は読み飛ばし、足りない部分は 0 として読む
+#define CHUNK_ID(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((d)<<24))
+#define STATE_MAGIC CHUNK_ID('T','G','B','S')
+#define STATE_VERSION 1
+
+#define CHUNK_GB   CHUNK_ID('G','B',' ',' ') // 機種/フレーム管理
+#define CHUNK_REGS CHUNK_ID('R','E','G','S') // I/O レジスタ
+#define CHUNK_CPU  CHUNK_ID('C','P','U',' ') // CPU レジスタ/クロック/DMA
+#define CHUNK_WRAM CHUNK_ID('W','R','A','M')
+#define CHUNK_VRAM CHUNK_ID('V','R','A','M')
+#define CHUNK_OAM  CHUNK_ID('O','A','M',' ')
+#define CHUNK_HRAM CHUNK_ID('H','R','A','M')
+#define CHUNK_PAL  CHUNK_ID('P','A','L',' ') // GBC パレット
+#define CHUNK_MBC  CHUNK_ID('M','B','C',' ')
+#define CHUNK_SRAM CHUNK_ID('S','R','A','M')
+#define CHUNK_APU  CHUNK_ID('A','P','U',' ')
+#define CHUNK_FILT CHUNK_ID('F','I','L','T')
+#define CHUNK_VFRM CHUNK_ID('V','F','R','M')
+#define CHUNK_END  CHUNK_ID('E','N','D',' ')
 
 gb::gb(renderer *ref,bool b_lcd,bool b_apu)
 {
 	m_renderer=ref;
+	this->b_lcd=b_lcd;
 
 	m_lcd=new lcd(this);
 	m_rom=new rom();
@@ -34,10 +63,19 @@ gb::gb(renderer *ref,bool b_lcd,bool b_apu)
 	m_mbc=new mbc(this);
 	m_cpu=new cpu(this);
 	m_cheat=new cheat(this);
+	m_rewind=NULL;
+	m_prof=NULL;
+	m_dbg=new debugger();
 	target=NULL;
+	link=NULL;
+	clear_counters();
+	b_suspend_tools=false;
+	hold_prof=NULL;
+	hold_trace=false;
 
 	m_renderer->reset();
 	m_renderer->set_sound_renderer(b_apu?m_apu->get_renderer():NULL);
+	m_apu->set_sound_enable(b_apu);
 
 	reset();
 
@@ -49,6 +87,10 @@ gb::~gb()
 {
 	m_renderer->set_sound_renderer(NULL);
 
+	delete m_rewind;
+	delete m_prof;
+	delete m_dbg;
+	delete m_cheat;
 	delete m_mbc;
 	delete m_rom;
 	delete m_apu;
@@ -58,6 +100,8 @@ gb::~gb()
 
 void gb::reset()
 {
+	regs.P1=0;
+	regs.SB=0;
 	regs.SC=0;
 	regs.DIV=0;
 	regs.TIMA=0;
@@ -69,6 +113,7 @@ void gb::reset()
 	regs.SCX=0;
 	regs.LY=153;
 	regs.LYC=0;
+	regs.DMA=0;
 	regs.BGP=0xFC;
 	regs.OBP1=0xFF;
 	regs.OBP2=0xFF;
@@ -110,6 +155,11 @@ void gb::unhook_extport()
 	hook_ext=false;
 }
 
+void gb::clear_counters()
+{
+	memset(&counters,0,sizeof(counters));
+}
+
 void gb::set_skip(int frame)
 {
 	skip_buf=frame;
@@ -127,212 +177,534 @@ bool gb::load_rom(byte *buf,int size,byte *ram,int ram_size)
 
 void gb::save_state(FILE *file)
 {
-	int tbl_ram[]={1,1,1,4,16,8}; // 0と1は保険
-	int has_bat[]={0,0,0,1,0,0,1,0,0,1,0,0,1,1,0,1,1,0,0,1,0,0,0,0,0,0,0,1,0,1,1,0}; // 0x20以下
+	file_state_io io(file);
+	save_state(&io);
+}
 
-	fwrite(&m_rom->get_info()->gb_type,sizeof(int),1,file); // ゲームボーイの種類 (GB:1,SGB:2,GBC:3 …)
+// 圧縮したもの (lz_pack) も読める
+bool gb::restore_state(FILE *file)
+{
+	byte head[8];
+	int size=(int)fread(head,1,8,file);
+	fseek(file,-size,SEEK_CUR);
+
+	if (lz_is_packed(head,size)){
+		std::vector<byte> buf;
+		byte tmp[0x1000];
+		while ((size=(int)fread(tmp,1,sizeof(tmp),file))>0)
+			buf.insert(buf.end(),tmp,tmp+size);
+		return !buf.empty()&&restore_state_mem(&buf[0],(int)buf.size());
+	}
 
-	if (m_rom->get_info()->gb_type==1){ // normal gb
-		fwrite(m_cpu->get_ram(),1,0x2000,file); // ram
-		fwrite(m_cpu->get_vram(),1,0x2000,file); // vram
-		fwrite(m_rom->get_sram(),1,tbl_ram[m_rom->get_info()->ram_size]*0x2000,file); // sram
-		fwrite(m_cpu->get_oam(),1,0xA0,file);
-		fwrite(m_cpu->get_stack(),1,0x80,file);
+	file_state_io io(file);
+	return restore_state(&io);
+}
 
-		int page,ram_page;
-		page=(m_mbc->get_rom()-m_rom->get_rom())/0x4000;
-		ram_page=(m_mbc->get_sram()-m_rom->get_sram())/0x2000;
+// buf に書き出して書いたバイト数を返す (size が足りなければ 0)
+int gb::save_state_mem(byte *buf,int size)
+{
+	mem_state_io io(buf,size);
+	save_state(&io);
+	return io.get_overflow()?0:io.get_pos();
+}
 
-		fwrite(&page,sizeof(int),1,file); // rom_page
-		fwrite(&ram_page,sizeof(int),1,file); // ram_page
+bool gb::restore_state_mem(byte *buf,int size)
+{
+	if (lz_is_packed(buf,size)){
+		std::vector<byte> raw;
+		if (!lz_unpack(buf,size,raw)||raw.empty())
+			return false;
+		return restore_state_mem(&raw[0],(int)raw.size());
+	}
 
-		int dmy=0;
+	mem_state_io io(buf,size);
+	return restore_state(&io);
+}
 
-		fwrite((const void *)m_cpu->get_regs(),sizeof(cpu_regs),1,file); // cpu_reg
-		fwrite((const void *)&regs,sizeof(gb_regs),1,file);//sys_reg
-		int halt=((*m_cpu->get_halt())?1:0);
-		fwrite((const void *)&halt,sizeof(int),1,file);
-		fwrite((const void *)&dmy,sizeof(int),1,file); // 元の版ではシリアル通信通信満了までのクロック数
-		                                               // (通信の仕様が大幅に変わったためダミーで埋めている)
-		int mbc_dat=m_mbc->get_state();
-		fwrite(&mbc_dat,sizeof(int),1,file);//MBC
+// save_state_mem に必要なバッファサイズ
+int gb::get_state_size()
+{
+	mem_state_io io(NULL,0);
+	save_state(&io);
+	return io.get_pos();
+}
 
-		int ext_is=m_mbc->is_ext_ram()?1:0;
-		fwrite(&ext_is,sizeof(int),1,file);
+// interval フレームごとに履歴を取る (0 で無効)。capacity は差分の合計の上限 (バイト)
+void gb::set_rewind(int interval,int capacity)
+{
+	delete m_rewind;
+	m_rewind=(interval>0)?new rewinder(this,interval,capacity):NULL;
+}
 
-		// ver 1.1 追加
-		fwrite(m_apu->get_stat(),sizeof(apu_stat),1,file);
-		fwrite(m_apu->get_mem(),1,0x30,file);
-		fwrite(m_apu->get_stat_cpy(),sizeof(apu_stat),1,file);
+void gb::set_profile(int interval)
+{
+#ifdef TGB_PROFILE
+	if (interval<=0){
+		delete m_prof;
+		m_prof=NULL;
+	}
+	else if (m_prof)
+		m_prof->set_interval(interval);
+	else
+		m_prof=new profiler(interval);
+#else
+	(void)interval;
+#endif
+}
 
-		byte resurved[256];
-		memset(resurved,0,256);
-		fwrite(resurved,1,256,file);//将来のために確保
+// ROM イメージと SRAM を共有した複製を作る (SRAM はどちらかが書き込む時に複製する)
+// それ以外の状態はステート (SRAM 抜き) を通して写す
+gb *gb::fork(renderer *ref)
+{
+	gb *ret=new gb(ref,b_lcd,m_apu->get_sound_enable());
+	if (!m_rom->get_loaded())
+		return ret;
+
+	ret->m_rom->share(m_rom);
+	ret->reset();
+
+	static thread_local std::vector<byte> buf(0x10000); // 足りなければ広げる
+	mem_state_io out(&buf[0],buf.size());
+	save_state(&out,false);
+	if (out.get_overflow()){
+		mem_state_io count(NULL,0);
+		save_state(&count,false);
+		buf.resize(count.get_pos());
+		mem_state_io retry(&buf[0],buf.size());
+		save_state(&retry,false);
 	}
-	else if (m_rom->get_info()->gb_type>=3){ // GB Colour / GBA
-		fwrite(m_cpu->get_ram(),1,0x2000*4,file); // ram
-		fwrite(m_cpu->get_vram(),1,0x2000*2,file); // vram
-		fwrite(m_rom->get_sram(),1,tbl_ram[m_rom->get_info()->ram_size]*0x2000,file); // sram
-		fwrite(m_cpu->get_oam(),1,0xA0,file);
-		fwrite(m_cpu->get_stack(),1,0x80,file);
+	mem_state_io in(&buf[0],buf.size());
+	ret->restore_state(&in); // HBlank DMA の転送元/先もここで ret 側のメモリに作り直す
 
-		int cpu_dat[16];
-		m_cpu->save_state(cpu_dat);
+	apu_snd *snd=m_apu->get_renderer(),*ret_snd=ret->m_apu->get_renderer();
+	ret_snd->set_echo(snd->get_echo());
+	ret_snd->set_lowpass(snd->get_lowpass());
+	for (int i=0;i<4;i++)
+		ret_snd->set_enable(i,snd->get_enable(i));
 
-		int page,ram_page;
-		page=(m_mbc->get_rom()-m_rom->get_rom())/0x4000;
-		ram_page=(m_mbc->get_sram()-m_rom->get_sram())/0x2000;
+	for (std::list<cheat_dat>::iterator it=m_cheat->get_first();it!=m_cheat->get_end();it++)
+		ret->m_cheat->add_cheat(&*it);
 
-		fwrite(&page,sizeof(int),1,file); // rom_page
-		fwrite(&ram_page,sizeof(int),1,file); // ram_page
-		fwrite(cpu_dat+0,sizeof(int),1,file);//int_page
-		fwrite(cpu_dat+1,sizeof(int),1,file);//vram_page
+	ret->use_gba=use_gba;
+	return ret;
+}
 
-		int dmy=0;
+// SRAM に書き込む前に呼ぶ。fork 先と共有していれば複製して参照先を付け替える
+void gb::unshare_sram()
+{
+	int page=(m_mbc->get_sram()-m_rom->get_sram())/0x2000;
+	int hdma[3]; // HBlank DMA が共有していた SRAM から転送中なら複製した方に付け替える
+	m_cpu->get_hdma_bank(hdma);
 
-		fwrite((const void *)m_cpu->get_regs(),sizeof(cpu_regs),1,file); // cpu_reg
-		fwrite((const void *)&regs,sizeof(gb_regs),1,file);//sys_reg
-		fwrite((const void *)&c_regs,sizeof(gbc_regs),1,file);//col_reg
-		fwrite(m_lcd->get_pal(0),sizeof(word),8*4*2,file);//palette
-		int halt=((*m_cpu->get_halt())?1:0);
-		fwrite((const void *)&halt,sizeof(int),1,file);
-		fwrite((const void *)&dmy,sizeof(int),1,file); // 元の版ではシリアル通信通信満了までのクロック数
+	if (!m_rom->unshare_sram())
+		return;
 
-		int mbc_dat=m_mbc->get_state();
-		fwrite(&mbc_dat,sizeof(int),1,file);//MBC
+	m_mbc->set_page((m_mbc->get_rom()-m_rom->get_rom())/0x4000,page);
+	m_cpu->set_hdma_bank(hdma);
+}
 
-		int ext_is=m_mbc->is_ext_ram()?1:0;
-		fwrite(&ext_is,sizeof(int),1,file);
+// 先行実行のように restore_state で巻き戻す区間の前後で呼ぶ
+// デバッガ/トレース/プロファイラ/カウンタはステートに入らないので、巻き戻される命令の分を残さない
+void gb::suspend_tools(bool suspend)
+{
+	if (suspend==b_suspend_tools)
+		return;
+	b_suspend_tools=suspend;
+	m_dbg->set_suspend(suspend);
+
+	if (suspend){
+		hold_prof=m_prof;
+		m_prof=NULL;
+		hold_trace=m_cpu->get_trace_enable();
+		m_cpu->set_trace(false);
+		hold_counters=counters;
+	}
+	else{
+		m_prof=hold_prof;
+		hold_prof=NULL;
+		m_cpu->set_trace(hold_trace);
+		counters=hold_counters;
+	}
+}
 
-		//その他諸々
-		fwrite(cpu_dat+2,sizeof(int),1,file);
-		fwrite(cpu_dat+3,sizeof(int),1,file);
-		fwrite(cpu_dat+4,sizeof(int),1,file);
-		fwrite(cpu_dat+5,sizeof(int),1,file);
-		fwrite(cpu_dat+6,sizeof(int),1,file);
-		fwrite(cpu_dat+7,sizeof(int),1,file);
+static void write_chunk(state_io *io,int id,int size)
+{
+	io->write(&id,sizeof(int));
+	io->write(&size,sizeof(int));
+}
 
-		// ver 1.1 追加
-		fwrite(m_apu->get_stat(),sizeof(apu_stat),1,file);
-		fwrite(m_apu->get_mem(),1,0x30,file);
-		fwrite(m_apu->get_stat_cpy(),sizeof(apu_stat),1,file);
-
-		byte resurved[256],reload=1;
-		memset(resurved,0,256);
-//		resurved[0]=1;
-		fwrite(&reload,1,1,file);
-		fwrite(resurved,1,256,file);//将来のために確保
+// b_sram=false なら SRAM を含めない (fork 用)
+void gb::save_state(state_io *io,bool b_sram)
+{
+	int tbl_ram[]={1,1,1,4,16,8}; // 0と1は保険
+	int gb_type=m_rom->get_info()->gb_type;
+	int ram_size=(gb_type>=3)?0x2000*4:0x2000;
+	int vram_size=(gb_type>=3)?0x2000*2:0x2000;
+	int sram_size=tbl_ram[m_rom->get_info()->ram_size]*0x2000;
+	int dat[32];
+
+	dat[0]=STATE_MAGIC;
+	dat[1]=STATE_VERSION;
+	io->write(dat,sizeof(int)*2);
+
+	memset(dat,0,sizeof(dat));
+	dat[0]=gb_type;
+	dat[1]=now_frame;
+	dat[2]=skip;
+	dat[3]=re_render;
+	dat[4]=m_lcd->get_win_count();
+	write_chunk(io,CHUNK_GB,sizeof(int)*5);
+	io->write(dat,sizeof(int)*5);
+
+	write_chunk(io,CHUNK_REGS,sizeof(gb_regs)+sizeof(gbc_regs));
+	io->write(&regs,sizeof(gb_regs));
+	io->write(&c_regs,sizeof(gbc_regs));
+
+	// cpu_regs, halt, cpu::save_state (8), cpu::save_state_ex (11), cpu::get_hdma_bank (3)
+	memset(dat,0,sizeof(dat));
+	dat[0]=(*m_cpu->get_halt())?1:0;
+	m_cpu->save_state(dat+1);
+	m_cpu->save_state_ex(dat+9);
+	m_cpu->get_hdma_bank(dat+20);
+	write_chunk(io,CHUNK_CPU,sizeof(cpu_regs)+sizeof(int)*23);
+	io->write(m_cpu->get_regs(),sizeof(cpu_regs));
+	io->write(dat,sizeof(int)*23);
+
+	write_chunk(io,CHUNK_WRAM,ram_size);
+	io->write(m_cpu->get_ram(),ram_size);
+	write_chunk(io,CHUNK_VRAM,vram_size);
+	io->write(m_cpu->get_vram(),vram_size);
+	write_chunk(io,CHUNK_OAM,0xA0+sizeof(m_cpu->spare_oam));
+	io->write(m_cpu->get_oam(),0xA0);
+	io->write(m_cpu->spare_oam,sizeof(m_cpu->spare_oam));
+	write_chunk(io,CHUNK_HRAM,0x80+sizeof(m_cpu->ext_mem));
+	io->write(m_cpu->get_stack(),0x80);
+	io->write(m_cpu->ext_mem,sizeof(m_cpu->ext_mem));
+
+	if (gb_type>=3){
+		write_chunk(io,CHUNK_PAL,sizeof(word)*8*4*2);
+		io->write(m_lcd->get_pal(0),sizeof(word)*8*4*2);
 	}
+
+	// 先頭ページ (MMM01), ROM/RAM ページ, mbc::save_state (24)
+	memset(dat,0,sizeof(dat));
+	dat[0]=m_rom->get_first();
+	dat[1]=(m_mbc->get_rom()-m_rom->get_rom())/0x4000;
+	dat[2]=(m_mbc->get_sram()-m_rom->get_sram())/0x2000;
+	m_mbc->save_state(dat+3);
+	write_chunk(io,CHUNK_MBC,sizeof(int)*27);
+	io->write(dat,sizeof(int)*27);
+
+	if (b_sram){
+		write_chunk(io,CHUNK_SRAM,sram_size);
+		io->write(m_rom->get_sram(),sram_size);
+	}
+
+	// apu::save_state_ex (4), apu_snd::save_state (12)
+	memset(dat,0,sizeof(dat));
+	m_apu->save_state_ex(dat);
+	m_apu->get_renderer()->save_state(dat+4);
+	write_chunk(io,CHUNK_APU,sizeof(apu_stat)*2+0x30+sizeof(int)*16);
+	io->write(m_apu->get_stat(),sizeof(apu_stat));
+	io->write(m_apu->get_stat_cpy(),sizeof(apu_stat));
+	io->write(m_apu->get_mem(),0x30);
+	io->write(dat,sizeof(int)*16);
+
+	write_chunk(io,CHUNK_FILT,m_apu->get_renderer()->get_filter_size());
+	m_apu->get_renderer()->save_filter(io);
+
+	// 描画途中のフレーム (次の LY=0 で表示される)
+	write_chunk(io,CHUNK_VFRM,160*144*2);
+	io->write(vframe,160*144*2);
+
+	write_chunk(io,CHUNK_END,0);
 }
 
-void gb::restore_state(FILE *file)
+struct state_chunk{
+	int id;
+	int pos; // restore_state の buf の中の位置
+	int size;
+};
+
+// size バイトを buf の後ろに読む
+// 残りが分かる時はそれより大きい size を読む前に断り、分からない (ファイル) 時は少しずつ確保する
+static bool read_chunk(state_io *io,int size,std::vector<byte> &buf)
+{
+	int rest=io->get_rest();
+	if (size<0||(rest>=0&&size>rest))
+		return false;
+
+	while (size>0){
+		int len=(size<0x10000)?size:0x10000;
+		size_t pos=buf.size();
+		buf.resize(pos+len);
+		if (io->read(&buf[pos],len)<len)
+			return false;
+		size-=len;
+	}
+	return true;
+}
+
+// rom_page は 4000-7FFF に見せる位置から 0x4000 を引いたもの (MBC5 のバンク 0 は -1)
+bool gb::check_page(int first,int rom_page,int sram_page)
+{
+	return first>=0&&first+rom_page+1>=0&&sram_page>=0&&
+		(long long)(first+rom_page+2)*0x4000<=m_rom->get_image_size()&&
+		(sram_page+1)*0x2000<=m_rom->get_sram_size();
+}
+
+// 途中で壊れていても中途半端な状態にならないように、全部読んで確かめてから反映する
+bool gb::restore_state(state_io *io)
+{
+	int tbl_ram[]={1,1,1,4,16,8}; // 0と1は保険
+	int dat[32];
+
+	if (io->read(dat,sizeof(int))<(int)sizeof(int)||dat[0]!=STATE_MAGIC){
+		io->skip(-(int)sizeof(int));
+
+		// 古い形式は読みながら反映するので、失敗したら元に戻す
+		std::vector<byte> backup(get_state_size());
+		save_state_mem(&backup[0],(int)backup.size());
+		if (restore_state_legacy(io)&&!io->get_overflow())
+			return true;
+		mem_state_io undo(&backup[0],(int)backup.size());
+		restore_state(&undo);
+		return false;
+	}
+	io->read(dat,sizeof(int)); // バージョン (今は 1 のみ)
+
+	std::vector<byte> buf;
+	std::vector<state_chunk> chunks;
+	for (;;){
+		state_chunk c={0,0,0};
+		if (io->read(&c.id,sizeof(int))<(int)sizeof(int)||io->read(&c.size,sizeof(int))<(int)sizeof(int))
+			return false; // CHUNK_END が無い
+		if (c.id==CHUNK_END)
+			break;
+		c.pos=(int)buf.size();
+		if (!read_chunk(io,c.size,buf))
+			return false;
+		chunks.push_back(c);
+	}
+
+	// 配列の大きさやポインタに関わる値を先に確かめる
+	for (size_t i=0;i<chunks.size();i++){
+		mem_state_io chunk(buf.data()+chunks[i].pos,chunks[i].size);
+		if (chunks[i].id==CHUNK_GB){
+			chunk.read(dat,sizeof(int));
+			if (dat[0]<1||dat[0]>4)
+				return false;
+		}
+		else if (chunks[i].id==CHUNK_MBC){
+			chunk.read(dat,sizeof(int)*3);
+			if (!check_page(dat[0],dat[1],dat[2]))
+				return false;
+		}
+	}
+
+	int gb_type=m_rom->get_info()->gb_type;
+	bool has_pal=false;
+	int hdma[3]={0,0,0}; // 古いステートには無い (0 なら次の HBlank で決め直す)
+
+	for (size_t i=0;i<chunks.size();i++){
+		int id=chunks[i].id,size=chunks[i].size;
+		mem_state_io chunk(buf.data()+chunks[i].pos,size);
+
+		switch(id){
+		case CHUNK_GB:
+			chunk.read(dat,sizeof(int)*5);
+			gb_type=m_rom->get_info()->gb_type=dat[0];
+			now_frame=dat[1];
+			skip=dat[2];
+			re_render=dat[3];
+			m_lcd->set_win_count(dat[4]);
+			break;
+		case CHUNK_REGS:
+			chunk.read(&regs,sizeof(gb_regs));
+			chunk.read(&c_regs,sizeof(gbc_regs));
+			break;
+		case CHUNK_CPU:
+			chunk.read(m_cpu->get_regs(),sizeof(cpu_regs));
+			chunk.read(dat,sizeof(int)*23);
+			*m_cpu->get_halt()=(dat[0]?true:false);
+			m_cpu->restore_state(dat+1);
+			m_cpu->restore_state_ex(dat+9);
+			memcpy(hdma,dat+20,sizeof(hdma));
+			break;
+		case CHUNK_WRAM:
+			chunk.read(m_cpu->get_ram(),(size<0x2000*4)?size:0x2000*4);
+			break;
+		case CHUNK_VRAM:
+			chunk.read(m_cpu->get_vram(),(size<0x2000*2)?size:0x2000*2);
+			break;
+		case CHUNK_OAM:
+			chunk.read(m_cpu->get_oam(),0xA0);
+			chunk.read(m_cpu->spare_oam,sizeof(m_cpu->spare_oam));
+			break;
+		case CHUNK_HRAM:
+			chunk.read(m_cpu->get_stack(),0x80);
+			chunk.read(m_cpu->ext_mem,sizeof(m_cpu->ext_mem));
+			break;
+		case CHUNK_PAL:
+			chunk.read(m_lcd->get_pal(0),sizeof(word)*8*4*2);
+			has_pal=true;
+			break;
+		case CHUNK_MBC:
+			chunk.read(dat,sizeof(int)*27);
+			m_rom->set_first(dat[0]);
+			m_mbc->set_page(dat[1],dat[2]);
+			m_mbc->restore_state(dat+3);
+			break;
+		case CHUNK_SRAM:{
+			int sram_size=tbl_ram[m_rom->get_info()->ram_size]*0x2000;
+			unshare_sram();
+			chunk.read(m_rom->get_sram(),(size<sram_size)?size:sram_size);
+			break;
+		}
+		case CHUNK_APU:
+			chunk.read(m_apu->get_stat(),sizeof(apu_stat));
+			chunk.read(m_apu->get_stat_cpy(),sizeof(apu_stat));
+			chunk.read(m_apu->get_mem(),0x30);
+			chunk.read(dat,sizeof(int)*16);
+			m_apu->restore_state_ex(dat);
+			m_apu->get_renderer()->restore_state(dat+4);
+			break;
+		case CHUNK_FILT:
+			m_apu->get_renderer()->restore_filter(&chunk);
+			break;
+		case CHUNK_VFRM:
+			chunk.read(vframe,160*144*2);
+			break;
+		default: // 知らない chunk (新しい版で追加されたもの)
+			break;
+		}
+	}
+
+	// MBC の chunk で ROM の先頭ページが変わるので最後に
+	m_cpu->set_hdma_bank(hdma);
+
+	if (has_pal&&gb_type>=3)
+		refresh_pal();
+	return true;
+}
+
+// ver 1.1 までの形式 (構造体を直接並べたもの)
+// 読み込みの途中で false を返した時は restore_state が元に戻す
+bool gb::restore_state_legacy(state_io *io)
 {
 	int tbl_ram[]={1,1,1,4,16,8}; // 0と1は保険
 	int has_bat[]={0,0,0,1,0,0,1,0,0,1,0,0,1,1,0,1,1,0,0,1,0,0,0,0,0,0,0,1,0,1,1,0}; // 0x20以下
 	int gb_type,dmy;
 
-	fread(&gb_type,sizeof(int),1,file);
+	if (io->read(&gb_type,sizeof(int))<(int)sizeof(int)||(gb_type!=1&&gb_type!=3&&gb_type!=4))
+		return false;
+	unshare_sram();
 
 	m_rom->get_info()->gb_type=gb_type;
 
 	if (gb_type==1){
-		fread(m_cpu->get_ram(),1,0x2000,file); // ram
-		fread(m_cpu->get_vram(),1,0x2000,file); // vram
-		fread(m_rom->get_sram(),1,tbl_ram[m_rom->get_info()->ram_size]*0x2000,file); // sram
-		fread(m_cpu->get_oam(),1,0xA0,file);
-		fread(m_cpu->get_stack(),1,0x80,file);
+		io->read(m_cpu->get_ram(),0x2000); // ram
+		io->read(m_cpu->get_vram(),0x2000); // vram
+		io->read(m_rom->get_sram(),tbl_ram[m_rom->get_info()->ram_size]*0x2000); // sram
+		io->read(m_cpu->get_oam(),0xA0);
+		io->read(m_cpu->get_stack(),0x80);
 
 		int page,ram_page;
-		fread(&page,sizeof(int),1,file); // rom_page
-		fread(&ram_page,sizeof(int),1,file); // ram_page
+		io->read(&page,sizeof(int)); // rom_page
+		io->read(&ram_page,sizeof(int)); // ram_page
+		if (!check_page(m_rom->get_first(),page,ram_page))
+			return false;
 		m_mbc->set_page(page,ram_page);
 
-		fread(m_cpu->get_regs(),sizeof(cpu_regs),1,file); // cpu_reg
-		fread((void *)&regs,sizeof(gb_regs),1,file); // sys_reg
+		io->read(m_cpu->get_regs(),sizeof(cpu_regs)); // cpu_reg
+		io->read((void *)&regs,sizeof(gb_regs)); // sys_reg
 		int halt;
-		fread(&halt,sizeof(int),1,file);
+		io->read(&halt,sizeof(int));
 		*m_cpu->get_halt()=((halt)?true:false);
-		fread(&dmy,sizeof(int),1,file);
+		io->read(&dmy,sizeof(int));
 
 		int mbc_dat;
-		fread(&mbc_dat,sizeof(int),1,file); // MBC
+		io->read(&mbc_dat,sizeof(int)); // MBC
 		m_mbc->set_state(mbc_dat);
 		int ext_is;
-		fread(&ext_is,sizeof(int),1,file);
+		io->read(&ext_is,sizeof(int));
 		m_mbc->set_ext_is(ext_is?true:false);
 
 		// ver 1.1 追加
 		byte tmp[256],tester[100];
-		fread(tmp,1,100,file); // とりあえず調べてみる
+		io->read(tmp,100); // とりあえず調べてみる
 		memset(tester,0,100);
 		if (memcmp(tmp,tester,100)!=0){
 			// apu 部分
-			fseek(file,-100,SEEK_CUR);
-			fread(m_apu->get_stat(),sizeof(apu_stat),1,file);
-			fread(m_apu->get_mem(),1,0x30,file);
-			fread(m_apu->get_stat_cpy(),sizeof(apu_stat),1,file);
+			io->skip(-100);
+			io->read(m_apu->get_stat(),sizeof(apu_stat));
+			io->read(m_apu->get_mem(),0x30);
+			io->read(m_apu->get_stat_cpy(),sizeof(apu_stat));
 		}
 
 		byte resurved[256];
-		fread(resurved,1,256,file);//将来のために確保
+		io->read(resurved,256);//将来のために確保
+		restore_state_ex(resurved);
 	}
 	else if (gb_type>=3){ // GB Colour / GBA
-		fread(m_cpu->get_ram(),1,0x2000*4,file); // ram
-		fread(m_cpu->get_vram(),1,0x2000*2,file); // vram
-		fread(m_rom->get_sram(),1,tbl_ram[m_rom->get_info()->ram_size]*0x2000,file); // sram
-		fread(m_cpu->get_oam(),1,0xA0,file);
-		fread(m_cpu->get_stack(),1,0x80,file);
+		io->read(m_cpu->get_ram(),0x2000*4); // ram
+		io->read(m_cpu->get_vram(),0x2000*2); // vram
+		io->read(m_rom->get_sram(),tbl_ram[m_rom->get_info()->ram_size]*0x2000); // sram
+		io->read(m_cpu->get_oam(),0xA0);
+		io->read(m_cpu->get_stack(),0x80);
 
 		int cpu_dat[16];
 
 		int page,ram_page;
-		fread(&page,sizeof(int),1,file); // rom_page
-		fread(&ram_page,sizeof(int),1,file); // ram_page
+		io->read(&page,sizeof(int)); // rom_page
+		io->read(&ram_page,sizeof(int)); // ram_page
+		if (!check_page(m_rom->get_first(),page,ram_page))
+			return false;
 		m_mbc->set_page(page,ram_page);
 		page=(m_mbc->get_rom()-m_rom->get_rom())/0x4000;
 		ram_page=(m_mbc->get_sram()-m_rom->get_sram())/0x2000;
 
-		fread(cpu_dat+0,sizeof(int),1,file);//int_page
-		fread(cpu_dat+1,sizeof(int),1,file);//vram_page
+		io->read(cpu_dat+0,sizeof(int));//int_page
+		io->read(cpu_dat+1,sizeof(int));//vram_page
 
 		int dmy;
-		fread(m_cpu->get_regs(),sizeof(cpu_regs),1,file); // cpu_reg
-		fread(&regs,sizeof(gb_regs),1,file);//sys_reg
-		fread(&c_regs,sizeof(gbc_regs),1,file);//col_reg
-		fread(m_lcd->get_pal(0),sizeof(word),8*4*2,file);//palette
+		io->read(m_cpu->get_regs(),sizeof(cpu_regs)); // cpu_reg
+		io->read(&regs,sizeof(gb_regs));//sys_reg
+		io->read(&c_regs,sizeof(gbc_regs));//col_reg
+		io->read(m_lcd->get_pal(0),sizeof(word)*8*4*2);//palette
 		int halt;
-		fread(&halt,sizeof(int),1,file);
+		io->read(&halt,sizeof(int));
 		*m_cpu->get_halt()=(halt?true:false);
-		fread(&dmy,sizeof(int),1,file); // 元の版ではシリアル通信通信満了までのクロック数
+		io->read(&dmy,sizeof(int)); // 元の版ではシリアル通信通信満了までのクロック数
 
 		int mbc_dat;
-		fread(&mbc_dat,sizeof(int),1,file); // MBC
+		io->read(&mbc_dat,sizeof(int)); // MBC
 		m_mbc->set_state(mbc_dat);
 		int ext_is;
-		fread(&ext_is,sizeof(int),1,file);
+		io->read(&ext_is,sizeof(int));
 		m_mbc->set_ext_is(ext_is?true:false);
 
 		//その他諸々
-		fread(cpu_dat+2,sizeof(int),1,file);
-		fread(cpu_dat+3,sizeof(int),1,file);
-		fread(cpu_dat+4,sizeof(int),1,file);
-		fread(cpu_dat+5,sizeof(int),1,file);
-		fread(cpu_dat+6,sizeof(int),1,file);
-		fread(cpu_dat+7,sizeof(int),1,file);
+		io->read(cpu_dat+2,sizeof(int));
+		io->read(cpu_dat+3,sizeof(int));
+		io->read(cpu_dat+4,sizeof(int));
+		io->read(cpu_dat+5,sizeof(int));
+		io->read(cpu_dat+6,sizeof(int));
+		io->read(cpu_dat+7,sizeof(int));
 		m_cpu->restore_state(cpu_dat);
 
 		// ver 1.1 追加
 		byte tmp[256],tester[100];
-		fread(tmp,1,100,file); // とりあえず調べてみる
+		io->read(tmp,100); // とりあえず調べてみる
 		memset(tester,0,100);
 		if (memcmp(tmp,tester,100)!=0){
 			// apu 部分
-			fseek(file,-100,SEEK_CUR);
-			fread(m_apu->get_stat(),sizeof(apu_stat),1,file);
-			fread(m_apu->get_mem(),1,0x30,file);
-			fread(m_apu->get_stat_cpy(),sizeof(apu_stat),1,file);
+			io->skip(-100);
+			io->read(m_apu->get_stat(),sizeof(apu_stat));
+			io->read(m_apu->get_mem(),0x30);
+			io->read(m_apu->get_stat_cpy(),sizeof(apu_stat));
 
-			fread(tmp,1,1,file);
+			io->read(tmp,1);
 			int i;
 			if (tmp[0])
 				for (i=0;i<64;i++)
@@ -345,8 +717,30 @@ void gb::restore_state(FILE *file)
 			}
 		}
 		byte resurved[256];
-		fread(resurved,1,256,file);//将来のために確保
+		io->read(resurved,256);//将来のために確保
+		restore_state_ex(resurved);
 	}
+
+	int hdma[3]={0,0,0}; // この形式には無いので次の HBlank で決め直す
+	m_cpu->set_hdma_bank(hdma);
+	return true;
+}
+
+// 予約領域に入れていた追加の状態 (chunk 形式になる前の一時的な版のファイル用)
+void gb::restore_state_ex(byte *buf)
+{
+	int dat[64];
+
+	memcpy(dat,buf,256);
+	if (dat[0]!=STATE_EX_MAGIC)
+		return;
+
+	m_cpu->restore_state_ex(dat+1);
+	m_apu->restore_state_ex(dat+12);
+	m_lcd->set_win_count(dat[16]);
+	now_frame=dat[17];
+	skip=dat[18];
+	re_render=dat[19];
 }
 
 void gb::refresh_pal()
@@ -370,7 +764,8 @@ void gb::run()
 			if (regs.LY==0){
 				m_renderer->refresh();
 				if (now_frame>=skip){
-					m_renderer->render_screen((byte*)vframe,160,144,16);
+					if (b_lcd)
+						m_renderer->render_screen((byte*)vframe,160,144,16);
 					now_frame=0;
 				}
 				else
@@ -428,6 +823,7 @@ void gb::run()
 					m_cpu->dma_dest+=16;
 					m_cpu->dma_dest&=0xfff0;
 					m_cpu->dma_rest--;
+					COUNTER(counters.hdma_bytes+=16);
 					if (!m_cpu->dma_rest)
 						m_cpu->dma_executing=false;
 
@@ -436,8 +832,9 @@ void gb::run()
 //					m_cpu->div_clock+=207*(m_cpu->speed?2:1);
 //					regs.STAT|=3;
 
-					if (now_frame>=skip)
+					if (b_lcd&&now_frame>=skip)
 						m_lcd->render(vframe,regs.LY);
+					COUNTER((b_lcd&&now_frame>=skip)?counters.lines_rendered++:counters.lines_skipped++);
 
 					regs.STAT&=0xfc;
 					m_cpu->exec(207); // state=3
@@ -465,8 +862,9 @@ void gb::run()
 					}
 					else{
 */						regs.STAT&=0xfc;
-						if (now_frame>=skip)
+						if (b_lcd&&now_frame>=skip)
 							m_lcd->render(vframe,regs.LY);
+						COUNTER((b_lcd&&now_frame>=skip)?counters.lines_rendered++:counters.lines_skipped++);
 						if ((regs.STAT&0x08))
 							m_cpu->irq(INT_LCDC);
 						m_cpu->exec(207); // state=0
@@ -482,7 +880,8 @@ void gb::run()
 				memset(vframe,0xff,160*144*2);
 				m_renderer->refresh();
 				if (now_frame>=skip){
-					m_renderer->render_screen((byte*)vframe,160,144,16);
+					if (b_lcd)
+						m_renderer->render_screen((byte*)vframe,160,144,16);
 					now_frame=0;
 				}
 				else
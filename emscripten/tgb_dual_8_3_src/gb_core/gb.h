@@ -22,9 +22,13 @@
 
 #include <stdio.h>
 #include <list>
+#include <atomic>
 
 #include "gb_types.h"
 #include "renderer.h"
+#include "state_io.h"
+#include "rewind.h"
+#include "counters.h"
 
 #define INT_VBLANK 1
 #define INT_LCDC 2
@@ -32,6 +36,8 @@
 #define INT_SERIAL 8
 #define INT_PAD 16
 
+#define RENDER_BLOCK 256 // APU の後処理をまとめて行うサンプル数 (apu_filter のバッファの大きさ)
+
 class gb;
 class cpu;
 class lcd;
@@ -40,6 +46,10 @@ class apu_snd;
 class rom;
 class mbc;
 class cheat;
+class link_cable;
+class profiler;
+class trace_ring;
+class debugger;
 
 struct ext_hook{
 	byte (*send)(byte);
@@ -176,26 +186,50 @@ public:
 	mbc *get_mbc() { return m_mbc; }
 	renderer *get_renderer() { return m_renderer; }
 	cheat *get_cheat() { return m_cheat; }
+	rewinder *get_rewinder() { return m_rewind; }
+	profiler *get_profiler() { return m_prof; } // set_profile するまでは NULL
+	debugger *get_debugger() { return m_dbg; }
 	gb *get_target() { return target; }
+	link_cable *get_link() { return link; }
 	gb_regs *get_regs() { return &regs; }
 	gbc_regs *get_cregs() { return &c_regs; }
+	word *get_vframe() { return vframe; } // 描画中のフレーム (160*144)
+	gb_counters *get_counters() { return &counters; } // TGB_COUNTERS の時だけ増える
+	void clear_counters();
 
 	void run();
 	void reset();
 	void set_skip(int frame);
 	void set_use_gba(bool use) { use_gba=use; }
+	void set_lcd_enable(bool enable) { b_lcd=enable; }
+	bool get_lcd_enable() { return b_lcd; }
 	bool load_rom(byte *buf,int size,byte *ram,int ram_size);
 	void save_state(FILE *file);
-	void restore_state(FILE *file);
+	bool restore_state(FILE *file);
+	void save_state(state_io *io,bool b_sram=true);
+	bool restore_state(state_io *io); // 壊れていたら何も変えずに false
+	int save_state_mem(byte *buf,int size);
+	bool restore_state_mem(byte *buf,int size);
+	int get_state_size();
+	void set_rewind(int interval,int capacity);
+	void set_profile(int interval); // interval クロックごとに PC を数える (0 で止める。TGB_PROFILE の時だけ)
+	gb *fork(renderer *ref);
+	void unshare_sram();
+	void suspend_tools(bool suspend); // 後で巻き戻す区間ではデバッガ/トレース/プロファイラ/カウンタに残さない
 
 	void refresh_pal();
 
 	void set_target(gb *tar) { target=tar; }
+	void set_link(link_cable *cable) { link=cable; } // 別スレッドで動かす相手とつなぐ (link_cable が呼ぶ)
 
 	void hook_extport(ext_hook *ext);
 	void unhook_extport();
 
 private:
+	bool restore_state_legacy(state_io *io);
+	void restore_state_ex(byte *buf);
+	bool check_page(int first,int rom_page,int sram_page); // ステートの MBC のページが ROM/SRAM に収まるか
+
 	cpu *m_cpu;
 	lcd *m_lcd;
 	apu *m_apu;
@@ -204,8 +238,12 @@ private:
 	renderer *m_renderer;
 
 	cheat *m_cheat;
+	rewinder *m_rewind;
+	profiler *m_prof;
+	debugger *m_dbg;
 
 	gb *target;
+	link_cable *link;
 
 	gb_regs regs;
 	gbc_regs c_regs;
@@ -215,12 +253,21 @@ private:
 
 	ext_hook hook_proc;
 
+	gb_counters counters;
+
+	// suspend_tools の間だけ外しておくもの
+	bool b_suspend_tools;
+	profiler *hold_prof;
+	bool hold_trace;
+	gb_counters hold_counters;
+
 	int skip,skip_buf;
 	int now_frame;
 	int re_render;
 
 	bool hook_ext;
 	bool use_gba;
+	bool b_lcd; // false の時は画面の描画を省略する (エミュレーションは続ける)
 };
 
 class cheat
@@ -266,6 +313,8 @@ public:
 	void render(void *buf,int scanline);
 	void reset();
 	void clear_win_count() { now_win_line=9; }
+	int get_win_count() { return now_win_line; }
+	void set_win_count(int line) { now_win_line=line&0xff; } // ステートから戻す時に範囲外を指さないように
 	word *get_pal(int num) { return col_pal[num]; }
 	word *get_mapped_pal(int num) { return mapped_pal[num]; }
 
@@ -317,9 +366,20 @@ public:
 	void update();
 	void reset();
 
+	void save_state_ex(int *dat);
+	void restore_state_ex(int *dat);
+
+	void set_sound_enable(bool enable);
+	bool get_sound_enable() { return b_sound; }
+
 private:
 	gb *ref_gb;
 	apu_snd *snd;
+
+	int bef_clock; // 前回の書き込み時のクロック
+	int clocks; // update までの残りクロック
+
+	bool b_sound; // false の時はレジスタの状態のみエミュレートする (書き込みキュー/波形生成なし)
 };
 
 class apu_snd : public sound_renderer
@@ -337,7 +397,15 @@ public:
 	bool get_lowpass(){ return b_lowpass; };
 
 
-	void render(short *buf,int sample);
+	void save_state(int *dat);
+	void restore_state(int *dat);
+	void save_filter(state_io *io);
+	void restore_filter(state_io *io);
+	int get_filter_size();
+
+	void render(short *buf,int sample) { render_stems(buf,NULL,sample); }
+	void render_stems(short *buf,short **stems,int sample);
+	int render_pending(short *buf,int max_sample);
 	void reset();
 
 private:
@@ -347,12 +415,25 @@ private:
 	short sq2_produce(int freq);
 	short wav_produce(int freq,bool interpolation);
 	short noi_produce(int freq);
+	unsigned int _mrand(dword degree);
+	void echo_filter(int *buf_l,int *buf_r,int count);
+	void lowpass_filter(int *buf_l,int *buf_r,int count);
 
 	apu_stat stat;
 	apu_stat stat_cpy,stat_tmp;
 	apu_que write_que[0x10000];
 	int que_count;
 	int bef_clock;
+	int pending_rest; // render_pending の端数 (クロック*サンプリング周波数)
+	int counter; // update の呼び出し回数 (エンベロープ等の周期用)
+
+	// 波形生成の位置
+	dword sq1_cur_pos,sq2_cur_pos,wav_cur_pos,noi_cur_pos;
+	dword sq1_cur_sample,sq2_cur_sample,wav_cur_pos2;
+	byte wav_bef_sample,wav_cur_sample;
+	int noi_cur_sample;
+	int rand_shift_reg; // ノイズの乱数 (LFSR)
+	dword rand_bef_degree; // 前回の段数 (0:7 段 1:15 段)
 	apu *ref_apu;
 
 	bool b_echo;
@@ -361,8 +442,9 @@ private:
 	byte mem[0x100];
 	bool b_enable[4];
 	
-	short filter[8820*2];
-	int counter;
+	short echo_buf[2][2000]; // エコーの遅延バッファ (L/R)
+	int echo_pos;
+	int lowpass_buf[2][4]; // ローパスフィルタの直前4サンプル (古い順)
 };
 
 class mbc
@@ -379,6 +461,8 @@ public:
 	int get_state();
 	void set_state(int dat);
 	void set_page(int rom,int sram);
+	void save_state(int *dat);
+	void restore_state(int *dat);
 
 	byte read(word adr);
 	void write(word adr,byte dat);
@@ -434,6 +518,11 @@ private:
 	gb *ref_gb;
 };
 
+// fork した gb 同士で共有するバッファの参照カウント
+struct rom_share{
+	std::atomic<int> count;
+};
+
 class rom
 {
 public:
@@ -444,20 +533,29 @@ public:
 	byte *get_rom() { return first_page; }
 	byte *get_sram() { return sram; }
 	bool get_loaded() { return b_loaded; }
+	byte *get_image() { return dat; } // 読み込んだ ROM 全体
+	int get_image_size() { return dat_size; }
 
 	bool has_battery();
 	int get_sram_size(); // byte単位
 
 	void set_first(int page) { first_page=dat+0x4000*page; }
+	int get_first() { return (int)(first_page-dat)/0x4000; }
 
 	bool load_rom(byte *buf,int size,byte *ram,int ram_size);
+	void share(rom *src);
+	bool is_sram_shared() { return sram_share&&sram_share->count.load(std::memory_order_acquire)>1; }
+	bool unshare_sram();
 
 private:
 	gb *ref_gb;
 	rom_info info;
 
 	byte *dat;
+	int dat_size;
 	byte *sram;
+	rom_share *dat_share;
+	rom_share *sram_share;
 
 	byte *first_page;
 
@@ -471,7 +569,7 @@ public:
 	cpu(gb *ref);
 	~cpu();
 
-	byte read(word adr) { return (ref_gb->get_cheat()->get_cheat_map()[adr])?ref_gb->get_cheat()->cheat_read(adr):read_direct(adr); }
+	byte read(word adr) { COUNTER(ref_gb->counters.reads[counter_region(adr)]++);return (ref_gb->get_cheat()->get_cheat_map()[adr])?ref_gb->get_cheat()->cheat_read(adr):read_direct(adr); }
 
 	byte read_direct(word adr);
 	void write(word adr,byte dat);
@@ -480,10 +578,17 @@ public:
 
 	void exec(int clocks);
 	byte seri_send(byte dat);
+	void seri_done(byte dat);
+	bool get_seri_pending() { return seri_pending; }
+	int get_seri_rest() { return (seri_occer==0x7fffffff)?-1:((seri_occer>total_clock)?seri_occer-total_clock:0); } // 送信完了までのクロック (送信中でなければ -1)
 	void irq(int irq_type);
 	void irq_process();
 	void reset();
-	void set_trace(bool trace) { b_trace=trace; }
+	void set_trace(bool trace); // 命令トレースを取る (初めての時にリングバッファを作る)
+	bool get_trace_enable() { return b_trace; }
+	void set_trace_size(int records); // リングバッファの命令数 (中身は消える)
+	trace_ring *get_trace() { return trace; }
+	static int dasm(char *S,const byte *A,word pc); // 逆アセンブル (dasm.cpp)
 
 	byte *get_vram() { return vram; }
 	byte *get_ram() { return ram; }
@@ -504,6 +609,8 @@ public:
 	void restore_state(int *dat);
 	void save_state_ex(int *dat);
 	void restore_state_ex(int *dat);
+	void get_hdma_bank(int *dat); // HBlank DMA の転送元/先のバンク (3 つ)
+	void set_hdma_bank(int *dat); // ROM/SRAM のページを決めてから呼ぶ
 
 private:
 	byte io_read(word adr);
@@ -511,8 +618,10 @@ private:
 	byte op_read() { return read(regs.PC++); }
 	word op_readw() { regs.PC+=2;return readw(regs.PC-2); }
 
-	int dasm(char *S,byte *A);
-	void log();
+	template<bool CHECK> void exec_loop(); // CHECK はブレークポイントを調べる版
+	void debug_access(int type,word adr,byte dat); // ブレークポイントに当たったかもしれない時
+	void log(); // トレースに 1 命令分を積む
+	int rom_bank() { return (int)((ref_gb->get_mbc()->get_rom()-ref_gb->get_rom()->get_rom())/0x4000)+1; } // 4000-7FFF のバンク
 
 	gb *ref_gb;
 	cpu_regs regs;
@@ -533,7 +642,10 @@ private:
 //	word org_pal[16][4];
 	int total_clock,rest_clock,sys_clock,seri_occer,div_clock;
 	bool halt,speed,speed_change,dma_executing;
+	bool seri_pending; // 送信は終わったが、相手との交換を link_cable に任せている
 	bool b_trace;
+	trace_ring *trace;
+	cpu_regs debug_regs; // 実行中の命令の前のレジスタ (exec_loop<true> の時だけ)
 	int dma_src;
 	int dma_dest;
 	int dma_rest;
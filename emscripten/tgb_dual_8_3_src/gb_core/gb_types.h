@@ -25,6 +25,6 @@
 
 typedef unsigned char byte;
 typedef unsigned short word;
-typedef unsigned long dword;
+typedef unsigned int dword;
 
 #endif
\ No newline at end of file
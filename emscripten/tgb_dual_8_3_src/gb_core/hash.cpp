@@ -0,0 +1,115 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 64bit ハッシュ (xxHash64 と同じ計算)
+
+#include "hash.h"
+#include <string.h>
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static inline qword rotl(qword v,int n)
+{
+	return (v<<n)|(v>>(64-n));
+}
+
+// リトルエンディアンとして読む (wasm/x86 とも)
+static inline qword read64(const unsigned char *p)
+{
+	qword ret;
+	memcpy(&ret,p,8);
+	return ret;
+}
+
+static inline qword read32(const unsigned char *p)
+{
+	unsigned int ret;
+	memcpy(&ret,p,4);
+	return ret;
+}
+
+static inline qword mix_round(qword acc,qword input)
+{
+	acc+=input*PRIME2;
+	acc=rotl(acc,31);
+	return acc*PRIME1;
+}
+
+static inline qword merge(qword acc,qword val)
+{
+	acc^=mix_round(0,val);
+	return acc*PRIME1+PRIME4;
+}
+
+qword hash64(const void *dat,int size,qword seed)
+{
+	const unsigned char *p=(const unsigned char*)dat;
+	const unsigned char *end=p+size;
+	qword h;
+
+	if (size>=32){
+		qword v1=seed+PRIME1+PRIME2;
+		qword v2=seed+PRIME2;
+		qword v3=seed;
+		qword v4=seed-PRIME1;
+
+		for (;end-p>=32;p+=32){
+			v1=mix_round(v1,read64(p));
+			v2=mix_round(v2,read64(p+8));
+			v3=mix_round(v3,read64(p+16));
+			v4=mix_round(v4,read64(p+24));
+		}
+
+		h=rotl(v1,1)+rotl(v2,7)+rotl(v3,12)+rotl(v4,18);
+		h=merge(h,v1);
+		h=merge(h,v2);
+		h=merge(h,v3);
+		h=merge(h,v4);
+	}
+	else
+		h=seed+PRIME5;
+
+	h+=(qword)size;
+
+	for (;end-p>=8;p+=8){
+		h^=mix_round(0,read64(p));
+		h=rotl(h,27)*PRIME1+PRIME4;
+	}
+	if (end-p>=4){
+		h^=read32(p)*PRIME1;
+		h=rotl(h,23)*PRIME2+PRIME3;
+		p+=4;
+	}
+	for (;p<end;p++){
+		h^=(*p)*PRIME5;
+		h=rotl(h,11)*PRIME1;
+	}
+
+	h^=h>>33;
+	h*=PRIME2;
+	h^=h>>29;
+	h*=PRIME3;
+	h^=h>>32;
+	return h;
+}
@@ -0,0 +1,142 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// フレームごとのハッシュの記録
+
+#include "hash_log.h"
+#include "gb.h"
+#include <stddef.h>
+#include <string.h>
+
+// ファイルの形式 : "TGBH" , バージョン , [フレーム番号 (4) , ハッシュ (8*HASH_COUNT)]...
+#define LOG_MAGIC 0x48424754 // "TGBH"
+#define LOG_VERSION 1
+
+struct log_record{
+	int frame;
+	qword dat[HASH_COUNT];
+};
+
+hash_log::hash_log()
+{
+	file=NULL;
+	frame_no=0;
+}
+
+hash_log::~hash_log()
+{
+	close();
+}
+
+bool hash_log::open(const char *path)
+{
+	close();
+	file=fopen(path,"wb");
+	if (!file)
+		return false;
+
+	int head[]={LOG_MAGIC,LOG_VERSION,HASH_COUNT};
+	fwrite(head,sizeof(int),3,file);
+	frame_no=0;
+	return true;
+}
+
+void hash_log::close()
+{
+	if (file)
+		fclose(file);
+	file=NULL;
+}
+
+void hash_log::calc(gb *ref,qword *dat)
+{
+	cpu *c=ref->get_cpu();
+	bool cgb=ref->get_rom()->get_info()->gb_type>=3;
+
+	dat[HASH_VFRAME]=hash64(ref->get_vframe(),160*144*sizeof(word));
+	dat[HASH_WRAM]=hash64(c->get_ram(),cgb?0x2000*4:0x2000);
+	dat[HASH_VRAM]=hash64(c->get_vram(),cgb?0x2000*2:0x2000);
+	dat[HASH_OAM]=hash64(c->get_oam(),0xA0);
+	dat[HASH_SRAM]=hash64(ref->get_rom()->get_sram(),ref->get_rom()->get_sram_size());
+
+	qword h=hash64(c->get_regs(),offsetof(cpu_regs,I)+1); // 後ろの詰め物は含めない
+	h=hash64(ref->get_regs(),sizeof(gb_regs),h);
+	h=hash64(ref->get_cregs(),sizeof(gbc_regs),h);
+	dat[HASH_REGS]=hash64(c->get_stack(),0x80,h);
+}
+
+void hash_log::frame(gb *ref)
+{
+	if (!file)
+		return;
+
+	log_record rec;
+	rec.frame=frame_no++;
+	calc(ref,rec.dat);
+	fwrite(&rec.frame,sizeof(int),1,file);
+	fwrite(rec.dat,sizeof(qword),HASH_COUNT,file);
+}
+
+static bool read_record(FILE *file,log_record *rec)
+{
+	return fread(&rec->frame,sizeof(int),1,file)==1&&
+		fread(rec->dat,sizeof(qword),HASH_COUNT,file)==HASH_COUNT;
+}
+
+int hash_log::compare(const char *path_a,const char *path_b,int *part)
+{
+	FILE *a=fopen(path_a,"rb"),*b=fopen(path_b,"rb");
+	int head_a[3]={0},head_b[3]={0};
+	int ret=-1;
+
+	*part=-1;
+	if (!a||!b||fread(head_a,sizeof(int),3,a)!=3||fread(head_b,sizeof(int),3,b)!=3||
+		head_a[0]!=LOG_MAGIC||memcmp(head_a,head_b,sizeof(head_a))!=0){
+		ret=HASH_LOG_ERROR;
+	}
+	else{
+		log_record rec_a,rec_b;
+		for (;;){
+			bool ok_a=read_record(a,&rec_a),ok_b=read_record(b,&rec_b);
+			if (!ok_a&&!ok_b)
+				break;
+			if (ok_a!=ok_b){ // 片方が短い
+				ret=ok_a?rec_a.frame:rec_b.frame;
+				break;
+			}
+			for (int i=0;i<HASH_COUNT;i++){
+				if (rec_a.dat[i]!=rec_b.dat[i]){
+					*part=i;
+					break;
+				}
+			}
+			if (*part>=0){
+				ret=rec_a.frame;
+				break;
+			}
+		}
+	}
+
+	if (a)
+		fclose(a);
+	if (b)
+		fclose(b);
+	return ret;
+}
@@ -0,0 +1,71 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// フレームごとのハッシュの記録 (動作が変わっていないかの確認用)
+//
+// 画面 (vframe)、WRAM、VRAM、OAM、SRAM、レジスタ (CPU/IO/HRAM) を
+// それぞれ hash64 し、フレーム番号と一緒にバイナリで書き出す。
+// ビルド (native/wasm, SIMD の有無等) 間でファイルを比べれば、
+// 最初にずれたフレームと場所が分かる。
+
+#ifndef HASH_LOG_H
+#define HASH_LOG_H
+
+#include <stdio.h>
+
+#include "gb_types.h"
+#include "hash.h"
+
+#define HASH_VFRAME 0
+#define HASH_WRAM 1
+#define HASH_VRAM 2
+#define HASH_OAM 3
+#define HASH_SRAM 4
+#define HASH_REGS 5
+#define HASH_COUNT 6
+
+#define HASH_LOG_ERROR -2 // compare で比べられなかった時
+
+class gb;
+
+class hash_log
+{
+public:
+	hash_log();
+	~hash_log();
+
+	bool open(const char *path);
+	void close();
+	bool is_open() { return file!=NULL; }
+
+	void frame(gb *ref); // フレームの区切りで呼ぶ
+	int get_frame() { return frame_no; }
+
+	static void calc(gb *ref,qword *dat); // dat は HASH_COUNT 個
+	// 最初に違うフレーム (同じなら -1、開けない・形式が違う時は HASH_LOG_ERROR)
+	// *part には違った場所 (HASH_XXX、長さが違う時は -1)
+	static int compare(const char *path_a,const char *path_b,int *part);
+
+private:
+	FILE *file;
+	int frame_no;
+};
+
+#endif
@@ -22,6 +22,7 @@
 // inline assembler あり 適宜変更せよ
 
 #include "gb.h"
+#include "bench.h"
 #include <memory.h>
 
 lcd::lcd(gb *ref)
@@ -57,6 +58,14 @@ void lcd::reset()
 	now_win_line=0;
 	layer_enable[0]=layer_enable[1]=layer_enable[2]=true;
 	sprite_count=0;
+
+	// GBC パレットは白で始める (不定のままだとステートから戻した時と描画が変わる)
+	word white=ref_gb->get_renderer()->map_color(0x7fff);
+	for (int i=0;i<16;i++)
+		for (int j=0;j<4;j++){
+			col_pal[i][j]=0x7fff;
+			mapped_pal[i][j]=white;
+		}
 }
 
 void lcd::bg_render(void *buf,int scanline)
@@ -745,6 +754,8 @@ void lcd::sprite_render_color(void *buf,int scanline)
 
 void lcd::render(void *buf,int scanline)
 {
+	BENCH_SCOPE(BENCH_LCD);
+
 	sprite_count=0;
 
 	if (ref_gb->get_rom()->get_info()->gb_type>=3){
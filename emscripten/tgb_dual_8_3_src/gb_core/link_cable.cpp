@@ -0,0 +1,188 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 通信ケーブル (2 台をそれぞれ別スレッドで動かす)
+
+#include "link_cable.h"
+#include "gb.h"
+
+link_cable::link_cable(gb *a,gb *b)
+{
+	g[0]=a;
+	g[1]=b;
+	for (int i=0;i<2;i++){
+		g[i]->set_target(NULL);
+		g[i]->set_link(this);
+	}
+
+	quantum=LINK_QUANTUM;
+	active_rest=0;
+	transfers=syncs=0;
+	b_threaded=false;
+#ifdef LINK_CABLE_THREAD
+	start.value=done.value=0;
+	start.sleeping=done.sleeping=0;
+	gen=0;
+	lines_req=0;
+	b_quit=false;
+#endif
+
+	set_threaded(true);
+}
+
+link_cable::~link_cable()
+{
+	set_threaded(false);
+	for (int i=0;i<2;i++)
+		g[i]->set_link(NULL);
+}
+
+void link_cable::set_threaded(bool threaded)
+{
+#ifdef LINK_CABLE_THREAD
+	if (threaded&&!b_threaded)
+		start_thread();
+	else if (!threaded&&b_threaded)
+		stop_thread();
+	b_threaded=threaded;
+#endif
+}
+
+// 次の区切りまでのライン数
+int link_cable::next_quantum(int rest)
+{
+	int n=(active_rest>0)?1:quantum;
+
+	for (int i=0;i<2;i++){
+		cpu *c=g[i]->get_cpu();
+		byte sc=g[i]->get_regs()->SC;
+		if ((sc&0x81)==0x80) // 受信待ち (相手がいつ送ってくるか分からない)
+			n=1;
+		int clocks=c->get_seri_rest();
+		if (clocks>=0){
+			int lines=clocks/(c->get_speed()?456*2:456)+1; // 転送が終わるライン
+			if (lines<n)
+				n=lines;
+		}
+		if (sc&0x80)
+			active_rest=LINK_ACTIVE_LINES;
+	}
+
+	if (n>rest)
+		n=rest;
+	active_rest-=n;
+	return n;
+}
+
+// 両方が止まっている間に、転送が終わった側の SB を交換する
+void link_cable::exchange()
+{
+	for (int i=0;i<2;i++){
+		cpu *c=g[i]->get_cpu();
+		if (c->get_seri_pending()){
+			c->seri_done(g[i^1]->get_cpu()->seri_send(g[i]->get_regs()->SB));
+			transfers++;
+			active_rest=LINK_ACTIVE_LINES;
+		}
+	}
+}
+
+void link_cable::run_lines(int lines)
+{
+	while (lines>0){
+		int n=next_quantum(lines);
+#ifdef LINK_CABLE_THREAD
+		if (b_threaded){
+			lines_req=n;
+			start.post(++gen);
+			for (int i=0;i<n;i++)
+				g[0]->run();
+			done.wait(gen);
+		}
+		else
+#endif
+		{
+			for (int i=0;i<n;i++)
+				g[0]->run();
+			for (int i=0;i<n;i++)
+				g[1]->run();
+		}
+		exchange();
+		syncs++;
+		lines-=n;
+	}
+}
+
+#ifdef LINK_CABLE_THREAD
+
+void link_cable::signal::post(unsigned int v)
+{
+	value.store(v);
+	if (sleeping.load()){
+		std::lock_guard<std::mutex> lk(lock);
+		cond.notify_all();
+	}
+}
+
+void link_cable::signal::wait(unsigned int v)
+{
+	for (int i=0;i<2000;i++){
+		if (value.load(std::memory_order_acquire)==v)
+			return;
+		if (i>=200)
+			std::this_thread::yield();
+	}
+
+	sleeping++;
+	{
+		std::unique_lock<std::mutex> lk(lock);
+		while (value.load()!=v)
+			cond.wait(lk);
+	}
+	sleeping--;
+}
+
+void link_cable::start_thread()
+{
+	b_quit=false;
+	worker=std::thread(&link_cable::thread_proc,this,gen);
+}
+
+void link_cable::stop_thread()
+{
+	b_quit=true;
+	start.post(++gen);
+	worker.join();
+}
+
+// 2 台目を受け持つ
+void link_cable::thread_proc(unsigned int cur)
+{
+	for (;;){
+		start.wait(++cur);
+		if (b_quit)
+			return;
+		for (int i=0;i<lines_req;i++)
+			g[1]->run();
+		done.post(cur);
+	}
+}
+
+#endif
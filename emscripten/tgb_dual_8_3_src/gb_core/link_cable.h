@@ -0,0 +1,102 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 通信ケーブル (2 台をそれぞれ別スレッドで動かす)
+//
+// 2 台を同じライン数ずつ進めて、区切り (quantum) ごとに待ち合わせる。
+// 送信側の転送が終わっても、相手には直接触らずに cpu::seri_pending を立てて止めておき、
+// 区切りで両方が止まっている間に SB を交換して割り込みを起こす。
+// 区切りの長さは両方の状態だけから決めるので、スレッドの進み具合によらず結果は同じになる
+// (スレッドを使わない場合も同じ結果になる)。
+//  - 送信中なら、転送が終わるラインで区切る
+//  - どちらかが SC の bit7 を立てている (送信待ち/受信待ち) か、最近交換した時は 1 ラインずつ
+//  - それ以外は set_quantum のライン数 (その間に始まった転送は、最大でその分だけ遅れる)
+// 赤外線 (RP) はつながない。
+
+#ifndef LINK_CABLE_H
+#define LINK_CABLE_H
+
+#include <atomic>
+
+#include "gb_types.h"
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define LINK_CABLE_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#define LINK_QUANTUM 16 // 通信していない時の区切り (ライン)
+#define LINK_ACTIVE_LINES 154 // 最後に通信してから、このライン数は 1 ラインずつ進める
+
+class gb;
+
+class link_cable
+{
+public:
+	link_cable(gb *a,gb *b); // a,b の set_target は外す
+	~link_cable();
+
+	void set_quantum(int lines) { quantum=(lines<1)?1:lines; }
+	void set_threaded(bool threaded); // false なら呼んだスレッドで交互に進める
+	bool get_threaded() { return b_threaded; }
+
+	void run_lines(int lines);
+	void run_frame() { run_lines(154); }
+
+	gb *get_gb(int num) { return g[num]; }
+	int get_transfers() { return transfers; } // 交換したバイト数
+	int get_syncs() { return syncs; } // 待ち合わせた回数
+
+private:
+	int next_quantum(int rest);
+	void exchange();
+
+	gb *g[2];
+	int quantum;
+	int active_rest;
+	int transfers,syncs;
+	bool b_threaded;
+
+#ifdef LINK_CABLE_THREAD
+	struct signal{ // 少し回ってから眠る (1 ラインごとに待ち合わせることがあるので)
+		std::atomic<unsigned int> value;
+		std::atomic<int> sleeping;
+		std::mutex lock;
+		std::condition_variable cond;
+
+		void post(unsigned int v);
+		void wait(unsigned int v);
+	};
+
+	void start_thread();
+	void stop_thread();
+	void thread_proc(unsigned int cur);
+
+	std::thread worker;
+	signal start,done; // 区切りの番号
+	unsigned int gen;
+	int lines_req;
+	bool b_quit;
+#endif
+};
+
+#endif
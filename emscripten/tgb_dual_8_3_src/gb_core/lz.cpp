@@ -0,0 +1,213 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ステート/SRAM 用の圧縮 (LZ4 のブロック形式)
+//
+// 系列 : [トークン (上位4bit リテラル長, 下位4bit 一致長-4)][リテラル長の続き]
+//        [リテラル][距離 (2byte)][一致長の続き]
+// 長さが 15 以上の時は 255 の並び + 残り で続きを表す。
+// 最後の系列はリテラルだけで、末尾 LAST_LITERALS バイトは必ずリテラルにする。
+
+#include "lz.h"
+#include <string.h>
+
+#define LZ_MAGIC 0x5a424754 // "TGBZ"
+#define HEADER_SIZE 8
+#define MIN_MATCH 4
+#define LAST_LITERALS 5
+#define MATCH_LIMIT 12 // 最後の一致はここより前から始めること
+#define MAX_DISTANCE 0xFFFF
+#define HASH_BITS 13
+
+static inline unsigned int read32(const byte *p)
+{
+	unsigned int ret;
+	memcpy(&ret,p,4);
+	return ret;
+}
+
+static inline int hash(unsigned int v)
+{
+	return (int)((v*2654435761u)>>(32-HASH_BITS));
+}
+
+static byte *write_length(byte *dst,int len)
+{
+	for (;len>=255;len-=255)
+		*dst++=255;
+	*dst++=(byte)len;
+	return dst;
+}
+
+int lz_bound(int size)
+{
+	return size+size/255+16;
+}
+
+int lz_compress(const byte *src,int size,byte *dst)
+{
+	int table[1<<HASH_BITS];
+	const byte *anchor=src,*p=src,*end=src+size;
+	const byte *limit=(size>MATCH_LIMIT)?end-MATCH_LIMIT:src;
+	byte *out=dst;
+
+	for (int i=0;i<(1<<HASH_BITS);i++)
+		table[i]=-1;
+
+	if (size>MATCH_LIMIT){
+		while (p<limit){
+			int h=hash(read32(p));
+			int pos=table[h];
+			table[h]=(int)(p-src);
+
+			if (pos<0||(p-src)-pos>MAX_DISTANCE||read32(src+pos)!=read32(p)){
+				p++;
+				continue;
+			}
+			const byte *ref=src+pos;
+
+			// 一致を後ろへ伸ばす
+			const byte *m=p+MIN_MATCH,*r=ref+MIN_MATCH;
+			const byte *match_end=end-LAST_LITERALS;
+			while (m<match_end&&*m==*r){
+				m++;
+				r++;
+			}
+
+			int lit=(int)(p-anchor),len=(int)(m-p)-MIN_MATCH;
+			byte *token=out++;
+			*token=(byte)(((lit<15)?lit:15)<<4);
+			if (lit>=15)
+				out=write_length(out,lit-15);
+			memcpy(out,anchor,lit);
+			out+=lit;
+
+			int dist=(int)(p-ref);
+			*out++=(byte)(dist&0xff);
+			*out++=(byte)(dist>>8);
+
+			*token|=(byte)((len<15)?len:15);
+			if (len>=15)
+				out=write_length(out,len-15);
+
+			p=anchor=m;
+		}
+	}
+
+	int lit=(int)(end-anchor);
+	*out++=(byte)(((lit<15)?lit:15)<<4);
+	if (lit>=15)
+		out=write_length(out,lit-15);
+	if (lit>0)
+		memcpy(out,anchor,lit);
+	out+=lit;
+
+	return (int)(out-dst);
+}
+
+int lz_decompress(const byte *src,int size,byte *dst,int dst_size)
+{
+	const byte *p=src,*end=src+size;
+	byte *out=dst,*out_end=dst+dst_size;
+
+	while (p<end){
+		int token=*p++;
+
+		int lit=token>>4;
+		if (lit==15){
+			int tmp;
+			do {
+				if (p>=end)
+					return -1;
+				tmp=*p++;
+				lit+=tmp;
+			} while (tmp==255);
+		}
+		if (lit>end-p||lit>out_end-out)
+			return -1;
+		if (lit>0)
+			memcpy(out,p,lit);
+		out+=lit;
+		p+=lit;
+
+		if (p>=end) // 最後の系列
+			break;
+
+		if (end-p<2)
+			return -1;
+		int dist=p[0]|(p[1]<<8);
+		p+=2;
+		if (dist==0||dist>out-dst)
+			return -1;
+
+		int len=token&15;
+		if (len==15){
+			int tmp;
+			do {
+				if (p>=end)
+					return -1;
+				tmp=*p++;
+				len+=tmp;
+			} while (tmp==255);
+		}
+		len+=MIN_MATCH;
+		if (len>out_end-out)
+			return -1;
+
+		const byte *ref=out-dist;
+		if (dist>=len)
+			memcpy(out,ref,len);
+		else if (dist==1) // 同じ値の並び (0 埋めの RAM 等)
+			memset(out,*ref,len);
+		else{ // 重なっているので1バイトずつ
+			for (int i=0;i<len;i++)
+				out[i]=ref[i];
+		}
+		out+=len;
+	}
+
+	return (int)(out-dst);
+}
+
+bool lz_is_packed(const byte *dat,int size)
+{
+	return size>=HEADER_SIZE&&read32(dat)==LZ_MAGIC;
+}
+
+void lz_pack(const byte *src,int size,std::vector<byte> &out)
+{
+	unsigned int head[2]={LZ_MAGIC,(unsigned int)size};
+
+	out.resize(HEADER_SIZE+lz_bound(size));
+	memcpy(&out[0],head,HEADER_SIZE);
+	out.resize(HEADER_SIZE+lz_compress(src,size,&out[HEADER_SIZE]));
+}
+
+bool lz_unpack(const byte *src,int size,std::vector<byte> &out)
+{
+	if (!lz_is_packed(src,size))
+		return false;
+
+	int raw_size=(int)read32(src+4);
+	if (raw_size<0||(long long)raw_size>(long long)size*255) // 1バイトから 255 バイト以上にはならない
+		return false;
+	out.resize(raw_size);
+	return lz_decompress(src+HEADER_SIZE,size-HEADER_SIZE,out.empty()?NULL:&out[0],raw_size)==raw_size;
+}
@@ -0,0 +1,41 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ステート/SRAM 用の圧縮 (LZ4 のブロック形式)
+//
+// 圧縮したファイルは "TGBZ" , 元のサイズ , 圧縮データ の順に並べる。
+// 先頭が "TGBZ" でなければ圧縮していないものとして扱う。
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <vector>
+
+#include "gb_types.h"
+
+int lz_bound(int size); // 圧縮後の最大サイズ
+int lz_compress(const byte *src,int size,byte *dst); // dst は lz_bound(size) 以上
+int lz_decompress(const byte *src,int size,byte *dst,int dst_size); // 壊れていれば -1
+
+bool lz_is_packed(const byte *dat,int size);
+void lz_pack(const byte *src,int size,std::vector<byte> &out);
+bool lz_unpack(const byte *src,int size,std::vector<byte> &out);
+
+#endif
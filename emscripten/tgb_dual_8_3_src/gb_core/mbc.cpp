@@ -231,6 +231,7 @@ void mbc::ext_write(word adr,byte dat)
 			if (!bef_cs&&mbc7_cs){
 				if (mbc7_state==5){
 					if (mbc7_write_enable){
+						ref_gb->unshare_sram();
 						*(ref_gb->get_rom()->get_sram()+mbc7_adr*2)=mbc7_buf>>8;
 						*(ref_gb->get_rom()->get_sram()+mbc7_adr*2+1)=mbc7_buf&0xff;
 //						fprintf(file,"書き込み完了\n");
@@ -309,6 +310,7 @@ void mbc::ext_write(word adr,byte dat)
 								}
 								else if ((mbc7_adr>>6)==1){
 									if (mbc7_write_enable){
+										ref_gb->unshare_sram();
 										for (i=0;i<256;i++){
 											*(ref_gb->get_rom()->get_sram()+i*2)=mbc7_buf>>8;
 											*(ref_gb->get_rom()->get_sram()+i*2)=mbc7_buf&0xff;
@@ -319,6 +321,7 @@ void mbc::ext_write(word adr,byte dat)
 								}
 								else if ((mbc7_adr>>6)==2){
 									if (mbc7_write_enable){
+										ref_gb->unshare_sram();
 										for (i=0;i<256;i++)
 											*(word*)(ref_gb->get_rom()->get_sram()+i*2)=0xffff;
 									}
@@ -461,6 +464,63 @@ void mbc::set_state(int dat)
 	}
 }
 
+// get_state に入りきらない分も含めた全状態 (24個)
+void mbc::save_state(int *dat)
+{
+	dat[0]=(mbc1_16_8?1:0);
+	dat[1]=mbc1_dat;
+	dat[2]=mbc3_latch;
+	dat[3]=mbc3_sec;
+	dat[4]=mbc3_min;
+	dat[5]=mbc3_hour;
+	dat[6]=mbc3_dayl;
+	dat[7]=mbc3_dayh;
+	dat[8]=mbc3_timer;
+	dat[9]=(ext_is_ram?1:0);
+	dat[10]=mbc5_dat;
+	dat[11]=(mbc7_write_enable?1:0);
+	dat[12]=(mbc7_idle?1:0);
+	dat[13]=mbc7_cs;
+	dat[14]=mbc7_sk;
+	dat[15]=mbc7_op_code;
+	dat[16]=mbc7_adr;
+	dat[17]=mbc7_dat;
+	dat[18]=mbc7_ret;
+	dat[19]=mbc7_state;
+	dat[20]=mbc7_buf;
+	dat[21]=mbc7_count;
+	dat[22]=(huc1_16_8?1:0);
+	dat[23]=huc1_dat;
+}
+
+void mbc::restore_state(int *dat)
+{
+	mbc1_16_8=(dat[0]?true:false);
+	mbc1_dat=dat[1];
+	mbc3_latch=dat[2];
+	mbc3_sec=dat[3];
+	mbc3_min=dat[4];
+	mbc3_hour=dat[5];
+	mbc3_dayl=dat[6];
+	mbc3_dayh=dat[7];
+	mbc3_timer=dat[8];
+	ext_is_ram=(dat[9]?true:false);
+	mbc5_dat=dat[10];
+	mbc7_write_enable=(dat[11]?true:false);
+	mbc7_idle=(dat[12]?true:false);
+	mbc7_cs=dat[13];
+	mbc7_sk=dat[14];
+	mbc7_op_code=dat[15];
+	mbc7_adr=dat[16];
+	mbc7_dat=dat[17];
+	mbc7_ret=dat[18];
+	mbc7_state=dat[19];
+	mbc7_buf=dat[20];
+	mbc7_count=dat[21];
+	huc1_16_8=(dat[22]?true:false);
+	huc1_dat=dat[23];
+}
+
 void mbc::set_page(int rom,int sram)
 {
 	rom_page=ref_gb->get_rom()->get_rom()+rom*0x4000;
@@ -0,0 +1,162 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 入力の記録/再生 (ムービー)
+
+#include "movie.h"
+#include "gb.h"
+
+// ファイルの形式
+// "TGBM" , バージョン , ROM のハッシュ (8) , フラグ , RTC (4*2) ,
+// 開始データの長さ , 開始データ , フレーム数 , パッド (1フレーム 1 バイト)
+#define MOVIE_MAGIC 0x4d424754 // "TGBM"
+#define MOVIE_VERSION 1
+#define FLAG_STATE 1
+
+movie::movie()
+{
+	mode=MOVIE_NONE;
+	pos=0;
+	hash=0;
+	b_state=false;
+	rtc_base=rtc_offset=0;
+}
+
+qword movie::rom_hash(gb *ref)
+{
+	return hash64(ref->get_rom()->get_image(),ref->get_rom()->get_image_size());
+}
+
+void movie::start_record(gb *ref,bool b_state,int rtc_base,int rtc_offset)
+{
+	hash=rom_hash(ref);
+	this->b_state=b_state;
+	this->rtc_base=rtc_base;
+	this->rtc_offset=rtc_offset;
+
+	if (b_state){
+		start.resize(ref->get_state_size());
+		ref->save_state_mem(&start[0],(int)start.size());
+	}
+	else{
+		ref->reset();
+		byte *sram=ref->get_rom()->get_sram();
+		start.assign(sram,sram+ref->get_rom()->get_sram_size());
+	}
+
+	pads.clear();
+	pos=0;
+	mode=MOVIE_RECORD;
+}
+
+void movie::record(int pad)
+{
+	if (mode!=MOVIE_RECORD)
+		return;
+	pads.push_back((byte)pad);
+	pos++;
+}
+
+bool movie::start_play(gb *ref)
+{
+	if (rom_hash(ref)!=hash)
+		return false;
+
+	if (b_state){
+		if (start.empty()||!ref->restore_state_mem(&start[0],(int)start.size()))
+			return false;
+	}
+	else{
+		ref->reset();
+		ref->unshare_sram();
+		int size=ref->get_rom()->get_sram_size();
+		if (!start.empty())
+			memcpy(ref->get_rom()->get_sram(),&start[0],((int)start.size()<size)?start.size():size);
+	}
+
+	pos=0;
+	mode=MOVIE_PLAY;
+	return true;
+}
+
+bool movie::next(int *pad)
+{
+	if (mode!=MOVIE_PLAY||pos>=(int)pads.size()){
+		mode=MOVIE_NONE;
+		return false;
+	}
+	*pad=pads[pos++];
+	return true;
+}
+
+bool movie::save(FILE *file)
+{
+	int head[]={MOVIE_MAGIC,MOVIE_VERSION};
+	int dat[]={b_state?FLAG_STATE:0,rtc_base,rtc_offset,(int)start.size()};
+	int frames=(int)pads.size();
+
+	fwrite(head,sizeof(int),2,file);
+	fwrite(&hash,sizeof(qword),1,file);
+	fwrite(dat,sizeof(int),4,file);
+	if (!start.empty())
+		fwrite(&start[0],1,start.size(),file);
+	fwrite(&frames,sizeof(int),1,file);
+	if (frames>0)
+		fwrite(&pads[0],1,frames,file);
+	return !ferror(file);
+}
+
+// ファイルの残りのバイト数 (壊れたファイルの長さで確保しないように)
+static long rest_size(FILE *file)
+{
+	long cur=ftell(file);
+	if (cur<0||fseek(file,0,SEEK_END)!=0)
+		return 0;
+	long end=ftell(file);
+	fseek(file,cur,SEEK_SET);
+	return end>cur?end-cur:0;
+}
+
+bool movie::load(FILE *file)
+{
+	int head[2],dat[4],frames;
+
+	mode=MOVIE_NONE;
+	if (fread(head,sizeof(int),2,file)!=2||head[0]!=MOVIE_MAGIC||head[1]>MOVIE_VERSION)
+		return false;
+	if (fread(&hash,sizeof(qword),1,file)!=1||fread(dat,sizeof(int),4,file)!=4||dat[3]<0||dat[3]>rest_size(file))
+		return false;
+
+	b_state=(dat[0]&FLAG_STATE)?true:false;
+	rtc_base=dat[1];
+	rtc_offset=dat[2];
+	start.resize(dat[3]);
+	if (dat[3]>0&&fread(&start[0],1,dat[3],file)!=(size_t)dat[3])
+		return false;
+
+	if (fread(&frames,sizeof(int),1,file)!=1||frames<0||frames>rest_size(file))
+		return false;
+	pads.resize(frames);
+	if (frames>0&&fread(&pads[0],1,frames,file)!=(size_t)frames)
+		return false;
+
+	pos=0;
+	return true;
+}
@@ -0,0 +1,77 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 入力の記録/再生 (ムービー)
+//
+// 開始時の状態 (ステート、または電源投入時の SRAM)、RTC の初期値、
+// ROM のハッシュと、フレームごとのパッドの状態を持つ。
+// フレームの区切り (gb::run の外) で 1 フレームに 1 回 record/next を呼ぶこと。
+// RTC は renderer 側のものなので、値を渡す/受け取るのは呼び出し側で行う。
+
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "gb_types.h"
+#include "hash.h"
+
+#define MOVIE_NONE 0
+#define MOVIE_RECORD 1
+#define MOVIE_PLAY 2
+
+class gb;
+
+class movie
+{
+public:
+	movie();
+
+	void start_record(gb *ref,bool b_state,int rtc_base,int rtc_offset); // b_state=false なら reset から
+	void record(int pad);
+	bool start_play(gb *ref); // ROM が違う時は false
+	bool next(int *pad); // 次のフレームのパッド。最後まで行ったら false
+	void stop() { mode=MOVIE_NONE; }
+
+	bool save(FILE *file);
+	bool load(FILE *file);
+
+	int get_mode() { return mode; }
+	int get_frame() { return pos; }
+	int get_length() { return (int)pads.size(); }
+	int get_pad(int frame) { return pads[frame]; } // 再生位置に関係なく読む
+	int get_rtc_base() { return rtc_base; }
+	int get_rtc_offset() { return rtc_offset; }
+
+private:
+	static qword rom_hash(gb *ref);
+
+	int mode;
+	int pos;
+
+	qword hash;
+	bool b_state;
+	int rtc_base,rtc_offset; // renderer の fixed_time, cur_time
+	std::vector<byte> start; // ステート (b_state) か SRAM
+	std::vector<byte> pads;
+};
+
+#endif
@@ -0,0 +1,157 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ゲーム側のコードのサンプリングプロファイラ
+
+#include "profiler.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+profiler::profiler(int interval)
+{
+	total=0;
+	set_interval(interval);
+}
+
+profiler::~profiler()
+{
+}
+
+void profiler::set_interval(int clocks)
+{
+	interval=(clocks<1)?1:clocks;
+	rest=interval;
+}
+
+void profiler::sample(word pc,int bank)
+{
+	rest+=interval;
+	if (rest<=0) // 長い命令や DMA で何周分も過ぎた時
+		rest=interval;
+	samples[((dword)bank<<16)|pc]++;
+	total++;
+}
+
+void profiler::clear()
+{
+	samples.clear();
+	total=0;
+	rest=interval;
+}
+
+// 1 行ずつ "BB:AAAA 名前" を読む (; 以降と [ で始まる行は無視)
+bool profiler::load_sym(const char *text)
+{
+	bool ret=false;
+	while (*text){
+		const char *end=strchr(text,'\n');
+		std::string line(text,end?end-text:strlen(text));
+		text=end?end+1:text+line.size();
+
+		size_t semi=line.find(';');
+		if (semi!=std::string::npos)
+			line.resize(semi);
+		if (line.empty()||line[0]=='[')
+			continue;
+
+		char *p;
+		dword bank=strtoul(line.c_str(),&p,16);
+		if (*p!=':')
+			continue;
+		dword adr=strtoul(p+1,&p,16);
+		while (*p==' '||*p=='\t')
+			p++;
+		size_t len=strcspn(p," \t\r");
+		if (!len||adr>0xFFFF)
+			continue;
+		syms[(bank<<16)|adr]=std::string(p,len);
+		ret=true;
+	}
+	return ret;
+}
+
+// key 以下で一番近いシンボル (同じバンクの中だけ)
+const char *profiler::find_sym(dword key,dword *base)
+{
+	std::map<dword,std::string>::iterator it=syms.upper_bound(key);
+	if (it==syms.begin())
+		return NULL;
+	--it;
+	if ((it->first>>16)!=(key>>16))
+		return NULL;
+	*base=it->first;
+	return it->second.c_str();
+}
+
+static bool by_count(const std::pair<dword,dword> &a,const std::pair<dword,dword> &b)
+{
+	return a.second!=b.second?a.second>b.second:a.first<b.first;
+}
+
+void profiler::write_report(FILE *file,int max_lines)
+{
+	std::vector<std::pair<dword,dword> > pcs(samples.begin(),samples.end());
+	std::sort(pcs.begin(),pcs.end(),by_count);
+
+	// シンボルごとにまとめる (シンボルが無ければ PC ごと)
+	std::map<dword,dword> funcs;
+	for (size_t i=0;i<pcs.size();i++){
+		dword base;
+		funcs[find_sym(pcs[i].first,&base)?base:pcs[i].first]+=pcs[i].second;
+	}
+	std::vector<std::pair<dword,dword> > sorted(funcs.begin(),funcs.end());
+	std::sort(sorted.begin(),sorted.end(),by_count);
+
+	double per=total?100.0/total:0;
+	fprintf(file,"; %d samples, every %d clocks\n",total,interval);
+	fprintf(file,"\n; by routine\n;  samples       %%  bank:addr  symbol\n");
+	for (size_t i=0;i<sorted.size()&&(int)i<max_lines;i++){
+		dword base;
+		const char *name=find_sym(sorted[i].first,&base);
+		fprintf(file,"%10u %6.2f%%  %02X:%04X  %s\n",sorted[i].second,sorted[i].second*per,
+			sorted[i].first>>16,sorted[i].first&0xFFFF,name?name:"");
+	}
+
+	fprintf(file,"\n; by address\n;  samples       %%  bank:addr  symbol\n");
+	for (size_t i=0;i<pcs.size()&&(int)i<max_lines;i++){
+		dword base;
+		const char *name=find_sym(pcs[i].first,&base);
+		fprintf(file,"%10u %6.2f%%  %02X:%04X  ",pcs[i].second,pcs[i].second*per,pcs[i].first>>16,pcs[i].first&0xFFFF);
+		if (!name)
+			fprintf(file,"\n");
+		else if (base==pcs[i].first)
+			fprintf(file,"%s\n",name);
+		else
+			fprintf(file,"%s+$%X\n",name,pcs[i].first-base);
+	}
+}
+
+bool profiler::save_report(const char *path,int max_lines)
+{
+	FILE *file=fopen(path,"w");
+	if (!file)
+		return false;
+	write_report(file,max_lines);
+	bool ret=!ferror(file);
+	fclose(file);
+	return ret;
+}
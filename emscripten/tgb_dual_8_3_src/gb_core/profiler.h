@@ -0,0 +1,69 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ゲーム側のコードのサンプリングプロファイラ (TGB_PROFILE を定義してビルドした時だけ)
+//
+// cpu::exec で interval クロックごとに、その時の PC と ROM バンクを数える。
+// 結果は .sym (RGBDS / no$gmb 形式の "BB:AAAA 名前") があればルーチン名を付けて書き出す。
+// バンクは 4000-7FFF だけ mbc::get_rom() から求め、それ以外の領域は 0 とする。
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "gb_types.h"
+
+#define PROFILE_DEFAULT_INTERVAL 456 // 1 ライン
+
+class profiler
+{
+public:
+	profiler(int interval);
+	~profiler();
+
+	void set_interval(int clocks);
+	int get_interval() { return interval; }
+
+	bool tick(int clocks) { return (rest-=clocks)<=0; } // true ならサンプルを取る番
+	void sample(word pc,int bank);
+	void clear();
+	int get_total() { return total; }
+
+	bool load_sym(const char *text); // .sym の中身 (何度でも追加できる)
+	void clear_sym() { syms.clear(); }
+
+	void write_report(FILE *file,int max_lines);
+	bool save_report(const char *path,int max_lines);
+
+private:
+	const char *find_sym(dword key,dword *base);
+
+	int interval;
+	int rest;
+	int total;
+	std::unordered_map<dword,dword> samples; // (バンク<<16)|PC -> 回数
+	std::map<dword,std::string> syms; // (バンク<<16)|アドレス -> 名前
+};
+
+#endif
@@ -28,12 +28,23 @@
 class sound_renderer
 {
 public:
+	virtual ~sound_renderer(){}
+
 	virtual void render(short *buf,int samples)=0;
+	// チャンネル別出力 (stems[0]～stems[3]) に対応しない実装は無音を返す
+	virtual void render_stems(short *buf,short **stems,int samples){
+		render(buf,samples);
+		for (int ch=0;ch<4;ch++)
+			for (int i=0;i<samples;i++)
+				stems[ch][i]=0;
+	}
 };
 
 class renderer
 {
 public:
+	virtual ~renderer(){}
+
 	void set_sound_renderer(sound_renderer *ref) { snd_render=ref; };
 
 	virtual void reset()=0;
@@ -0,0 +1,154 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 巻き戻し用のステート履歴
+
+#include "rewind.h"
+#include "gb.h"
+#include <string.h>
+
+// 差分の形式 : [ゼロの数 (word)][非ゼロ部の長さ (word)][非ゼロ部]... の繰り返し
+#define MAX_RUN 0xFFFF
+#define MIN_ZERO_RUN 4 // これより短いゼロは非ゼロ部に含めてしまう
+
+rewinder::rewinder(gb *ref,int interval,int capacity)
+{
+	ref_gb=ref;
+	this->interval=(interval<1)?1:interval;
+	this->capacity=capacity;
+	counter=0;
+	used=0;
+}
+
+rewinder::~rewinder()
+{
+}
+
+void rewinder::clear()
+{
+	cur.clear();
+	deltas.clear();
+	counter=0;
+	used=0;
+}
+
+void rewinder::frame()
+{
+	if (cur.empty()||++counter>=interval)
+		push();
+}
+
+void rewinder::push()
+{
+	int size=ref_gb->get_state_size();
+
+	if ((int)cur.size()!=size){ // GB の種類が変わった等で続けられない
+		clear();
+		cur.resize(size);
+		ref_gb->save_state_mem(&cur[0],size);
+		return;
+	}
+
+	tmp.resize(size);
+	ref_gb->save_state_mem(&tmp[0],size);
+
+	deltas.push_back(std::vector<byte>());
+	encode(&tmp[0],&cur[0],size,deltas.back());
+	used+=(int)deltas.back().size();
+	cur.swap(tmp);
+	counter=0;
+
+	while (used>capacity&&!deltas.empty()){
+		used-=(int)deltas.front().size();
+		deltas.pop_front();
+	}
+}
+
+bool rewinder::rewind()
+{
+	if (cur.empty())
+		return false;
+
+	if (counter==0){ // 最新のステートの時点にいるなら1つ前へ
+		if (deltas.empty())
+			return false;
+		apply(deltas.back(),&cur[0],(int)cur.size());
+		used-=(int)deltas.back().size();
+		deltas.pop_back();
+	}
+
+	ref_gb->restore_state_mem(&cur[0],(int)cur.size());
+	counter=0;
+	return true;
+}
+
+void rewinder::encode(const byte *old_dat,const byte *new_dat,int size,std::vector<byte> &out)
+{
+	int pos=0;
+
+	out.clear();
+	while (pos<size){
+		int zero=0;
+		while (pos+zero<size&&zero<MAX_RUN&&old_dat[pos+zero]==new_dat[pos+zero])
+			zero++;
+		pos+=zero;
+
+		int lit=0,run=0;
+		while (pos+lit<size&&lit<MAX_RUN){
+			if (old_dat[pos+lit]==new_dat[pos+lit]){
+				if (++run>=MIN_ZERO_RUN){
+					lit-=run-1;
+					break;
+				}
+			}
+			else
+				run=0;
+			lit++;
+		}
+
+		int base=(int)out.size();
+		out.resize(base+4+lit);
+		out[base+0]=zero&0xff;
+		out[base+1]=zero>>8;
+		out[base+2]=lit&0xff;
+		out[base+3]=lit>>8;
+		for (int i=0;i<lit;i++)
+			out[base+4+i]=old_dat[pos+i]^new_dat[pos+i];
+		pos+=lit;
+	}
+}
+
+void rewinder::apply(const std::vector<byte> &delta,byte *dat,int size)
+{
+	int pos=0,i=0,len=(int)delta.size();
+
+	while (i+4<=len){
+		int zero=delta[i]|(delta[i+1]<<8);
+		int lit=delta[i+2]|(delta[i+3]<<8);
+		i+=4;
+		pos+=zero;
+		if (pos+lit>size||i+lit>len)
+			break;
+		for (int j=0;j<lit;j++)
+			dat[pos+j]^=delta[i+j];
+		pos+=lit;
+		i+=lit;
+	}
+}
@@ -0,0 +1,68 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 巻き戻し用のステート履歴
+//
+// interval フレームごとに save_state_mem でステートを取り、直前のものとの
+// XOR 差分をゼロ連長圧縮して積んでいく。最新のステートだけはそのまま持ち、
+// 差分を新しい順にあてていくことで過去にさかのぼる。
+// 差分の合計が capacity バイトを超えたら古いものから捨てる。
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <vector>
+#include <deque>
+
+#include "gb_types.h"
+
+class gb;
+
+class rewinder
+{
+public:
+	rewinder(gb *ref,int interval,int capacity);
+	~rewinder();
+
+	void frame(); // フレームの区切り (gb::run の外) で毎フレーム呼ぶこと
+	bool rewind(); // 1つ前のステートに戻す。戻れなければ false
+	void clear();
+
+	int get_count() { return (int)deltas.size(); }
+	int get_used() { return used; }
+
+private:
+	void push();
+
+	static void encode(const byte *old_dat,const byte *new_dat,int size,std::vector<byte> &out);
+	static void apply(const std::vector<byte> &delta,byte *dat,int size);
+
+	gb *ref_gb;
+	int interval;
+	int capacity;
+	int counter; // 最後にステートを取ってからのフレーム数
+	int used; // 差分の合計バイト数
+
+	std::vector<byte> cur; // 最新のステート
+	std::vector<byte> tmp;
+	std::deque<std::vector<byte> > deltas; // cur から1つずつ過去へ戻る差分 (新しいものが後ろ)
+};
+
+#endif
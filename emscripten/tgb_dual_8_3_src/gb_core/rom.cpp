@@ -30,13 +30,34 @@ rom::rom()
 	b_loaded=false;
 
 	dat=NULL;
+	dat_size=0;
 	sram=NULL;
+	dat_share=NULL;
+	sram_share=NULL;
+}
+
+static rom_share *new_share()
+{
+	rom_share *ret=new rom_share;
+	ret->count=1;
+	return ret;
+}
+
+// 最後の参照ならバッファを解放する
+static void release(byte *&buf,rom_share *&share)
+{
+	if (share&&share->count.fetch_sub(1)==1){
+		free(buf);
+		delete share;
+	}
+	buf=NULL;
+	share=NULL;
 }
 
 rom::~rom()
 {
-	free(dat);
-	free(sram);
+	release(dat,dat_share);
+	release(sram,sram_share);
 }
 
 bool rom::has_battery()
@@ -63,8 +84,8 @@ bool rom::load_rom(byte *buf,int size,byte *ram,int ram_size)
 	byte momocol_title[16]={0x4D,0x4F,0x4D,0x4F,0x43,0x4F,0x4C,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00};
 
 	if (b_loaded){
-		free(dat);
-		free(sram);
+		release(dat,dat_share);
+		release(sram,sram_share);
 	}
 
 	memcpy(info.cart_name,buf+0x134,16);
@@ -88,11 +109,14 @@ bool rom::load_rom(byte *buf,int size,byte *ram,int ram_size)
 
 	dat=(byte*)malloc(size);
 	memcpy(dat,buf,size);
+	dat_share=new_share();
+	dat_size=size;
 	first_page=dat;
 
 	word sum=0;
 
 	sram=(byte*)malloc(get_sram_size());
+	sram_share=new_share();
 	if (ram)
 		memcpy(sram,ram,ram_size&0xffffff00);
 
@@ -100,3 +124,37 @@ bool rom::load_rom(byte *buf,int size,byte *ram,int ram_size)
 
 	return true;
 }
+
+// src と ROM イメージ/SRAM を共有する (fork 用)
+void rom::share(rom *src)
+{
+	if (b_loaded){
+		release(dat,dat_share);
+		release(sram,sram_share);
+	}
+
+	info=src->info;
+	dat=src->dat;
+	dat_share=src->dat_share;
+	dat_share->count++;
+	sram=src->sram;
+	sram_share=src->sram_share;
+	sram_share->count++;
+	dat_size=src->dat_size;
+	first_page=src->first_page;
+	b_loaded=src->b_loaded;
+}
+
+// SRAM が共有されていれば自分用に複製する (複製したら true)
+bool rom::unshare_sram()
+{
+	if (!is_sram_shared())
+		return false;
+
+	byte *tmp=(byte*)malloc(get_sram_size());
+	memcpy(tmp,sram,get_sram_size());
+	release(sram,sram_share);
+	sram=tmp;
+	sram_share=new_share();
+	return true;
+}
@@ -0,0 +1,111 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// サウンド出力用リングバッファ
+
+#include "sound_ring.h"
+#include <stdlib.h>
+#include <memory.h>
+
+#define RATE_CONTROL_DELTA 0.005 // 充填率による補正幅 (±0.5%)
+
+sound_ring::sound_ring(int frames,int channels)
+{
+	size=1;
+	while (size<frames)
+		size<<=1;
+	mask=size-1;
+	this->channels=channels;
+
+	dat=(short*)malloc(size*channels*sizeof(short));
+	memset(dat,0,size*channels*sizeof(short));
+
+	head.store(0);
+	tail.store(0);
+	clear_pos.store(0);
+	b_clear.store(false);
+	rest=0;
+}
+
+sound_ring::~sound_ring()
+{
+	free(dat);
+}
+
+int sound_ring::write(const short *buf,int frames)
+{
+	unsigned int h=head.load(std::memory_order_relaxed);
+	unsigned int t=tail.load(std::memory_order_acquire);
+	int space=size-(int)(h-t);
+
+	if (frames>space) // 溢れた分は捨てる (rate control が戻すまでの間だけ)
+		frames=space;
+
+	int pos=h&mask;
+	int first=(frames<size-pos)?frames:size-pos; // 末尾で折り返す
+	memcpy(dat+pos*channels,buf,first*channels*sizeof(short));
+	memcpy(dat,buf+first*channels,(frames-first)*channels*sizeof(short));
+
+	head.store(h+frames,std::memory_order_release);
+	return frames;
+}
+
+// 1フレーム分として生成すべきサンプル数を返す
+// 充填率 50% を目標に、少なければ多めに、多ければ少なめに生成させる
+int sound_ring::next_request(double nominal)
+{
+	double fill=(double)get_fill()/size;
+	double ratio=1.0+RATE_CONTROL_DELTA*(1.0-2.0*fill);
+
+	rest+=nominal*ratio;
+	int ret=(int)rest;
+	rest-=ret;
+	return ret;
+}
+
+int sound_ring::read(short *buf,int frames)
+{
+	unsigned int t=tail.load(std::memory_order_relaxed);
+	if (b_clear.exchange(false,std::memory_order_acquire)){
+		unsigned int c=clear_pos.load(std::memory_order_relaxed);
+		if ((int)(c-t)>0) // もう読み進めていたらそのまま
+			t=c;
+	}
+	unsigned int h=head.load(std::memory_order_acquire);
+	int avail=(int)(h-t);
+
+	if (frames>avail)
+		frames=avail;
+
+	int pos=t&mask;
+	int first=(frames<size-pos)?frames:size-pos;
+	memcpy(buf,dat+pos*channels,first*channels*sizeof(short));
+	memcpy(buf+first*channels,dat,(frames-first)*channels*sizeof(short));
+
+	tail.store(t+frames,std::memory_order_release);
+	return frames;
+}
+
+// producer 側から呼ぶ。捨てるのは次の read() (読み出し位置は consumer だけが動かす)
+void sound_ring::clear()
+{
+	clear_pos.store(head.load(std::memory_order_relaxed),std::memory_order_relaxed);
+	b_clear.store(true,std::memory_order_release);
+}
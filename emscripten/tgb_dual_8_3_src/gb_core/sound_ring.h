@@ -0,0 +1,65 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// サウンド出力用リングバッファ (lock-free single producer / single consumer)
+//
+// エミュレーション側が 1 フレームごとに write() で積み、オーディオコールバック
+// (ScriptProcessorNode, AudioWorklet, ネイティブのオーディオスレッド) が read() で取り出す。
+// お互いに相手の位置は書き換えないのでロックは要らない。
+// clear() も捨てる位置を頼むだけで、実際に tail を進めるのは次の read()。
+
+#ifndef SOUND_RING_H
+#define SOUND_RING_H
+
+#include <atomic>
+
+class sound_ring
+{
+public:
+	sound_ring(int frames,int channels); // frames は 2 のべき乗に切り上げ
+	~sound_ring();
+
+	// producer 側
+	int write(const short *buf,int frames);
+	int next_request(double nominal);
+	void clear(); // 今積んである分を捨てるよう頼む
+
+	// consumer 側
+	int read(short *buf,int frames);
+
+	int get_fill() { return (int)(head.load(std::memory_order_acquire)-tail.load(std::memory_order_acquire)); }
+	int get_size() { return size; }
+	int get_channels() { return channels; }
+
+private:
+	short *dat;
+	int size;
+	int mask;
+	int channels;
+
+	std::atomic<unsigned int> head; // 書き込み位置 (producer のみ更新)
+	std::atomic<unsigned int> tail; // 読み出し位置 (consumer のみ更新)
+	std::atomic<unsigned int> clear_pos; // clear() された時の head (producer のみ更新)
+	std::atomic<bool> b_clear; // clear_pos まで捨てる (consumer が read で下ろす)
+
+	double rest; // next_request の端数
+};
+
+#endif
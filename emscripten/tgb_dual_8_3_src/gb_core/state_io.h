@@ -0,0 +1,99 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//-----------------------------------------
+// ステートセーブ用の入出力 (ファイル/メモリ)
+
+#ifndef STATE_IO_H
+#define STATE_IO_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gb_types.h"
+
+class state_io
+{
+public:
+	virtual ~state_io() {}
+	virtual int write(const void *dat,int size)=0;
+	virtual int read(void *dat,int size)=0;
+	virtual void skip(int size)=0; // 負の値で巻き戻し
+	virtual int get_rest() { return -1; } // 読める残りのバイト数 (分からなければ -1)
+	virtual bool get_overflow()=0; // 読み書きが足りなかった
+};
+
+class file_state_io : public state_io
+{
+public:
+	file_state_io(FILE *file) { this->file=file; }
+
+	int write(const void *dat,int size) { return (int)fwrite(dat,1,size,file); }
+	int read(void *dat,int size) { return (int)fread(dat,1,size,file); }
+	void skip(int size) { fseek(file,size,SEEK_CUR); }
+	bool get_overflow() { return feof(file)||ferror(file); }
+
+private:
+	FILE *file;
+};
+
+// 呼び出し側が用意したバッファに読み書きする
+// 溢れた分は書かずに捨て、get_overflow() で分かるようにする
+// buf が NULL の時は書き込まずにサイズだけ数える
+class mem_state_io : public state_io
+{
+public:
+	mem_state_io(byte *buf,int size) { this->buf=buf; this->size=size; pos=0; overflow=false; }
+
+	int write(const void *dat,int len){
+		if (buf){
+			if (pos+len>size){
+				overflow=true;
+				len=(pos<size)?size-pos:0;
+			}
+			memcpy(buf+pos,dat,len);
+		}
+		pos+=len;
+		return len;
+	}
+	int read(void *dat,int len){
+		int rest=(pos<size)?size-pos:0;
+		if (len>rest){ // 足りない分は 0 で埋める
+			overflow=true;
+			memset((byte*)dat+rest,0,len-rest);
+			len=rest;
+		}
+		memcpy(dat,buf+pos,len);
+		pos+=len;
+		return len;
+	}
+	void skip(int len) { pos+=len; if (pos<0) pos=0; }
+
+	int get_pos() { return pos; }
+	int get_rest() { return (pos<size)?size-pos:0; }
+	bool get_overflow() { return overflow; }
+
+private:
+	byte *buf;
+	int size;
+	int pos;
+	bool overflow;
+};
+
+#endif
@@ -0,0 +1,213 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ステート/SRAM の書き出しスレッド
+
+#include "state_writer.h"
+#include "gb.h"
+#include "lz.h"
+#include <stdio.h>
+
+#ifndef STATE_WRITER_THREAD
+#include <emscripten.h>
+#endif
+
+state_writer::state_writer()
+{
+#ifdef STATE_WRITER_THREAD
+	b_quit=false;
+	b_busy=false;
+	worker=std::thread(&state_writer::thread_proc,this);
+#else
+	b_scheduled=false;
+#endif
+}
+
+state_writer::~state_writer()
+{
+#ifdef STATE_WRITER_THREAD
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		b_quit=true;
+	}
+	cond.notify_all();
+	worker.join();
+#else
+	flush();
+#endif
+}
+
+// 今の状態をメモリに取り、書き込みは後で行う
+void state_writer::save_state(gb *ref,const char *path,bool compress)
+{
+	static thread_local std::vector<byte> tmp; // 使い回す (別スレッドの gb からも呼べるようにスレッドごと)
+	if (tmp.empty())
+		tmp.resize(ref->get_state_size());
+
+	int size=ref->save_state_mem(&tmp[0],(int)tmp.size());
+	if (size==0){ // 前より大きくなった (ROM が変わった等)
+		tmp.resize(ref->get_state_size());
+		size=ref->save_state_mem(&tmp[0],(int)tmp.size());
+	}
+
+	job j;
+	j.path=path;
+	j.dat.assign(tmp.begin(),tmp.begin()+size);
+	j.compress=compress;
+	push(j);
+}
+
+void state_writer::write(const char *path,const byte *dat,int size,bool compress)
+{
+	job j;
+	j.path=path;
+	j.dat.assign(dat,dat+size);
+	j.compress=compress;
+	push(j);
+}
+
+// 同じパスのものが待っていれば中身だけ差し替える
+void state_writer::enqueue(job &j)
+{
+	for (std::deque<job>::iterator it=jobs.begin();it!=jobs.end();it++){
+		if (it->path==j.path){
+			it->dat.swap(j.dat);
+			it->compress=j.compress;
+			return;
+		}
+	}
+	jobs.push_back(job());
+	jobs.back().path.swap(j.path);
+	jobs.back().dat.swap(j.dat);
+	jobs.back().compress=j.compress;
+}
+
+// 一時ファイルに書いてから置き換える (途中で落ちても前のファイルが残る)
+void state_writer::write_file(job &j)
+{
+	if (j.compress&&!j.dat.empty()){
+		std::vector<byte> packed;
+		lz_pack(&j.dat[0],(int)j.dat.size(),packed);
+		j.dat.swap(packed);
+	}
+
+	std::string tmp_path=j.path+".tmp";
+	FILE *file=fopen(tmp_path.c_str(),"wb");
+	if (!file)
+		return;
+
+	bool ok=(fwrite(j.dat.data(),1,j.dat.size(),file)==j.dat.size());
+	ok=(fclose(file)==0)&&ok;
+	if (ok)
+		ok=(rename(tmp_path.c_str(),j.path.c_str())==0);
+	if (!ok)
+		remove(tmp_path.c_str());
+}
+
+#ifdef STATE_WRITER_THREAD
+
+void state_writer::push(job &j)
+{
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		enqueue(j);
+	}
+	cond.notify_all();
+}
+
+void state_writer::thread_proc()
+{
+	std::unique_lock<std::mutex> lk(lock);
+	for (;;){
+		cond.wait(lk,[this]{ return b_quit||!jobs.empty(); });
+		if (jobs.empty()) // b_quit で残りも無い
+			break;
+
+		job j;
+		j.path.swap(jobs.front().path);
+		j.dat.swap(jobs.front().dat);
+		j.compress=jobs.front().compress;
+		jobs.pop_front();
+		b_busy=true;
+
+		lk.unlock();
+		write_file(j);
+		lk.lock();
+
+		b_busy=false;
+		cond.notify_all();
+	}
+}
+
+void state_writer::flush()
+{
+	std::unique_lock<std::mutex> lk(lock);
+	cond.wait(lk,[this]{ return jobs.empty()&&!b_busy; });
+}
+
+int state_writer::get_pending()
+{
+	std::lock_guard<std::mutex> lk(lock);
+	return (int)jobs.size()+(b_busy?1:0);
+}
+
+#else // Web 版 (スレッド無し)
+
+void state_writer::push(job &j)
+{
+	enqueue(j);
+
+	if (!b_scheduled){
+		b_scheduled=true;
+		emscripten_async_call(async_proc,this,0);
+	}
+}
+
+// 1回に1つずつ書き、残りはまた次に回す
+void state_writer::async_proc(void *arg)
+{
+	state_writer *self=(state_writer*)arg;
+	self->b_scheduled=false;
+	if (self->jobs.empty())
+		return;
+
+	write_file(self->jobs.front());
+	self->jobs.pop_front();
+
+	if (!self->jobs.empty()){
+		self->b_scheduled=true;
+		emscripten_async_call(async_proc,self,0);
+	}
+}
+
+void state_writer::flush()
+{
+	while (!jobs.empty()){
+		write_file(jobs.front());
+		jobs.pop_front();
+	}
+}
+
+int state_writer::get_pending()
+{
+	return (int)jobs.size();
+}
+
+#endif
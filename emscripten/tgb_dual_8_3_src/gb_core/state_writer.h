@@ -0,0 +1,88 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ステート/SRAM の書き出しスレッド
+//
+// 呼び出し側 (エミュレーションのスレッド) ではメモリへの書き出しだけを行い、
+// ファイルへの書き込みは別スレッドで行う。pthread の無い Web 版では
+// emscripten_async_call でフレームの外に回す。
+// 同じパスへの書き込みが溜まっている時は新しいものだけを残す。
+// compress=true の時は書き込む側で lz_pack してから書く。
+// Web 版では予約した呼び出しが後から来るので、終了まで破棄しないこと。
+
+#ifndef STATE_WRITER_H
+#define STATE_WRITER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+
+#include "gb_types.h"
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define STATE_WRITER_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+class gb;
+
+class state_writer
+{
+public:
+	state_writer();
+	~state_writer(); // 溜まっている分は書き終えてから戻る
+
+	void save_state(gb *ref,const char *path,bool compress);
+	void write(const char *path,const byte *dat,int size,bool compress);
+	void flush(); // 溜まっている分を書き終えるまで待つ
+
+	int get_pending();
+
+private:
+	struct job {
+		std::string path;
+		std::vector<byte> dat;
+		bool compress;
+	};
+
+	void push(job &j);
+	void enqueue(job &j);
+	static void write_file(job &j);
+
+#ifdef STATE_WRITER_THREAD
+	void thread_proc();
+
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable cond; // 仕事が来た/終わった
+	bool b_quit;
+	bool b_busy;
+#else
+	static void async_proc(void *arg);
+
+	bool b_scheduled;
+#endif
+
+	std::deque<job> jobs;
+};
+
+#endif
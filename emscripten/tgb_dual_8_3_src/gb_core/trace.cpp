@@ -0,0 +1,92 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 命令トレースのリングバッファ
+
+#include "trace.h"
+#include "gb.h"
+#include <string.h>
+
+trace_ring::trace_ring(int capacity)
+{
+	buf.resize(capacity<1?1:capacity);
+	clear();
+}
+
+trace_ring::~trace_ring()
+{
+}
+
+void trace_ring::get_records(std::vector<trace_record> &out)
+{
+	out.clear();
+	if (b_full)
+		out.insert(out.end(),buf.begin()+cur,buf.end());
+	out.insert(out.end(),buf.begin(),buf.begin()+cur);
+}
+
+bool trace_ring::save(FILE *file)
+{
+	std::vector<trace_record> recs;
+	get_records(recs);
+
+	dword head[3]={TRACE_VERSION,sizeof(trace_record),(dword)recs.size()};
+	fwrite("TGBT",1,4,file);
+	fwrite(head,sizeof(head),1,file);
+	if (!recs.empty())
+		fwrite(&recs[0],sizeof(trace_record),recs.size(),file);
+	return !ferror(file);
+}
+
+bool trace_ring::save(const char *path)
+{
+	FILE *file=fopen(path,"wb");
+	if (!file)
+		return false;
+	bool ret=save(file);
+	fclose(file);
+	return ret;
+}
+
+bool trace_ring::load(FILE *file,std::vector<trace_record> &out)
+{
+	char magic[4];
+	dword head[3];
+	if (fread(magic,1,4,file)!=4||memcmp(magic,"TGBT",4)||fread(head,sizeof(head),1,file)!=1)
+		return false;
+	if (head[0]!=TRACE_VERSION||head[1]!=sizeof(trace_record))
+		return false;
+	out.resize(head[2]);
+	return out.empty()||fread(&out[0],sizeof(trace_record),out.size(),file)==out.size();
+}
+
+void trace_ring::format(char *str,const trace_record &rec)
+{
+	char mnemonic[32];
+	int len=cpu::dasm(mnemonic,rec.op,rec.pc);
+
+	char bytes[12]="";
+	for (int i=0;i<len;i++)
+		sprintf(bytes+i*3,"%02X ",rec.op[i]);
+
+	sprintf(str,"%02X:%04X  %-9s %-18s AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X %c%c %u",
+		rec.bank,rec.pc,bytes,mnemonic,rec.af,rec.bc,rec.de,rec.hl,rec.sp,
+		(rec.flags&TRACE_IME)?'I':'-',(rec.flags&TRACE_SPEED)?'2':'-',rec.clock);
+}
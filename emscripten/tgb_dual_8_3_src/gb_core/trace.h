@@ -0,0 +1,77 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 命令トレースのリングバッファ
+//
+// cpu::set_trace(true) の間、命令を実行する前の PC とレジスタを 1 命令 24 バイトで積む。
+// 一杯になったら古いものから上書きするので、不具合が起きた所で止めて save すれば
+// 直前の capacity 命令分が残る。ファイルは tgb_trace (cpu::dasm で逆アセンブル) で読む。
+//
+// ファイルの形式 : "TGBT" [版 (dword)][レコードの大きさ (dword)][数 (dword)][レコード (古い順)]...
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "gb_types.h"
+
+#define TRACE_DEFAULT_RECORDS (1<<16)
+#define TRACE_VERSION 1
+
+#define TRACE_IME 1 // trace_record::flags
+#define TRACE_SPEED 2
+
+struct trace_record{
+	word pc;
+	word bank; // 4000-7FFF の時の ROM バンク (それ以外は 0)
+	byte op[3]; // PC からの 3 バイト (I/O 領域は 0)
+	byte flags;
+	word af,bc,de,hl,sp; // F は GB の形式
+	dword clock; // cpu::get_clock()
+};
+
+class trace_ring
+{
+public:
+	trace_ring(int capacity);
+	~trace_ring();
+
+	trace_record *next() { trace_record *ret=&buf[cur]; if (++cur==(int)buf.size()){ cur=0;b_full=true; } return ret; }
+	void clear() { cur=0;b_full=false; }
+
+	int get_capacity() { return (int)buf.size(); }
+	int get_count() { return b_full?(int)buf.size():cur; }
+	void get_records(std::vector<trace_record> &out); // 古い順
+
+	bool save(FILE *file);
+	bool save(const char *path);
+	static bool load(FILE *file,std::vector<trace_record> &out);
+
+	static void format(char *str,const trace_record &rec); // 1 行のテキストに (80 文字程度)
+
+private:
+	std::vector<trace_record> buf;
+	int cur;
+	bool b_full;
+};
+
+#endif
@@ -0,0 +1,112 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// batch_runner の速度を測る
+//
+// tgb_batch <rom> [-n instances] [-j threads] [-f frames] [-o adr:size] [-s]
+// 入力はインスタンスごとに決まった乱数で 8 フレームごとに変える。
+// -s で画面を作らない (RAM だけを見る場合)。
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "batch_runner.h"
+
+int main(int argc,char **argv)
+{
+	if (argc<2){
+		fprintf(stderr,"usage: tgb_batch <rom> [-n instances] [-j threads] [-f frames] [-o adr:size] [-s]\n");
+		return 2;
+	}
+
+	int count=64,threads=0,frames=600;
+	bool b_render=true;
+	std::vector<std::pair<int,int> > ranges;
+	for (int i=2;i<argc;i++){
+		if (!strcmp(argv[i],"-n")&&i+1<argc)
+			count=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"-j")&&i+1<argc)
+			threads=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"-f")&&i+1<argc)
+			frames=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"-o")&&i+1<argc){
+			char *end;
+			int adr=(int)strtol(argv[++i],&end,16);
+			ranges.push_back(std::make_pair(adr,(*end==':')?atoi(end+1):1));
+		}
+		else if (!strcmp(argv[i],"-s"))
+			b_render=false;
+		else{
+			fprintf(stderr,"unknown option %s\n",argv[i]);
+			return 2;
+		}
+	}
+
+	FILE *file=fopen(argv[1],"rb");
+	if (!file){
+		fprintf(stderr,"cannot read %s\n",argv[1]);
+		return 2;
+	}
+	std::vector<byte> rom;
+	byte tmp[0x10000];
+	int size;
+	while ((size=(int)fread(tmp,1,sizeof(tmp),file))>0)
+		rom.insert(rom.end(),tmp,tmp+size);
+	fclose(file);
+
+	batch_runner runner(threads);
+	runner.set_render(b_render);
+	for (size_t i=0;i<ranges.size();i++)
+		runner.set_observe(ranges[i].first,ranges[i].second);
+	if (rom.empty()||!runner.load_rom(&rom[0],(int)rom.size(),count)){
+		fprintf(stderr,"cannot load %s\n",argv[1]);
+		return 2;
+	}
+
+	std::vector<int> pads(count);
+	std::vector<unsigned int> seeds(count);
+	for (int i=0;i<count;i++)
+		seeds[i]=i*2654435761u+1;
+
+	for (int frame=0;frame<frames;frame++){
+		if (frame%8==0)
+			for (int i=0;i<count;i++){
+				seeds[i]=seeds[i]*1103515245+12345;
+				pads[i]=(seeds[i]>>16)&0xff;
+			}
+		runner.step(&pads[0]);
+	}
+
+	double avg=0,min_avg=1e30,max_avg=0,max_max=0;
+	for (int i=0;i<count;i++){
+		double lat=runner.get_latency(i);
+		avg+=lat/count;
+		if (lat<min_avg) min_avg=lat;
+		if (lat>max_avg) max_avg=lat;
+		if (runner.get_max_latency(i)>max_max) max_max=runner.get_max_latency(i);
+	}
+	double fps=runner.get_fps();
+	printf("%d instances x %d frames on %d threads\n",count,frames,runner.get_threads());
+	printf("aggregate %.0f frames/s (%.0f per thread), step %.1f us\n",fps,fps/runner.get_threads(),count*1000000.0/(fps>0?fps:1));
+	printf("instance latency avg %.1f us (min %.1f, max %.1f), worst frame %.1f us\n",avg,min_avg,max_avg,max_max);
+	return 0;
+}
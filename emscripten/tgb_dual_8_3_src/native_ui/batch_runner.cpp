@@ -0,0 +1,252 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 複数の gb をまとめて進める
+
+#include "batch_runner.h"
+#include "../gb_core/gb.h"
+#include "../web_ui/dmy_renderer.h"
+#include <chrono>
+
+static double now_usec()
+{
+	using namespace std::chrono;
+	return duration<double,std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+batch_runner::batch_runner(int threads)
+{
+	if (threads<=0)
+		threads=(int)std::thread::hardware_concurrency();
+	if (threads<=0)
+		threads=1;
+
+	obs_size=0;
+	b_render=true;
+	generation=0;
+	remain=0;
+	b_quit=false;
+	frames=0;
+	elapse_usec=0;
+
+	for (int i=0;i<threads;i++)
+		queues.push_back(new work_queue());
+	// 0 番は step() を呼んだスレッドが受け持つ
+	for (int i=1;i<threads;i++)
+		workers.push_back(std::thread(&batch_runner::thread_proc,this,i));
+}
+
+batch_runner::~batch_runner()
+{
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		b_quit=true;
+	}
+	cond_start.notify_all();
+	for (size_t i=0;i<workers.size();i++)
+		workers[i].join();
+
+	release();
+	for (size_t i=0;i<queues.size();i++)
+		delete queues[i];
+}
+
+void batch_runner::release()
+{
+	for (size_t i=0;i<insts.size();i++){
+		delete insts[i].ref;
+		delete insts[i].render;
+	}
+	insts.clear();
+}
+
+bool batch_runner::load_rom(const byte *dat,int size,int count)
+{
+	release();
+	if (count<=0)
+		return false;
+
+	insts.resize(count);
+	for (int i=0;i<count;i++){
+		instance &inst=insts[i];
+		inst.render=new dmy_renderer();
+		if (i==0){
+			inst.ref=new gb(inst.render,b_render,false);
+			if (!inst.ref->load_rom((byte*)dat,size,NULL,0)){
+				delete inst.ref;
+				delete inst.render;
+				insts.clear();
+				return false;
+			}
+			start_state.resize(inst.ref->get_state_size());
+			inst.ref->save_state_mem(&start_state[0],(int)start_state.size());
+		}
+		else
+			inst.ref=insts[0].ref->fork(inst.render); // ROM は共有
+		inst.pad=0;
+		inst.obs.resize(obs_size);
+	}
+	clear_stats();
+	return true;
+}
+
+void batch_runner::set_render(bool render)
+{
+	b_render=render;
+	for (size_t i=0;i<insts.size();i++)
+		insts[i].ref->set_lcd_enable(render);
+}
+
+void batch_runner::set_observe(int adr,int size)
+{
+	ranges.push_back(std::make_pair(adr,size));
+	obs_size+=size;
+	for (size_t i=0;i<insts.size();i++)
+		insts[i].obs.resize(obs_size);
+}
+
+void batch_runner::reset(int num)
+{
+	insts[num].ref->restore_state_mem(&start_state[0],(int)start_state.size());
+}
+
+const word *batch_runner::get_frame(int num)
+{
+	return insts[num].ref->get_vframe();
+}
+
+void batch_runner::run_one(int num)
+{
+	instance &inst=insts[num];
+	double start=now_usec();
+
+	inst.render->set_pad(inst.pad);
+	for (int line=0;line<154;line++)
+		inst.ref->run();
+
+	cpu *c=inst.ref->get_cpu();
+	byte *p=inst.obs.empty()?NULL:&inst.obs[0];
+	for (size_t i=0;i<ranges.size();i++)
+		for (int j=0;j<ranges[i].second;j++)
+			*(p++)=c->read_direct((word)(ranges[i].first+j));
+
+	double usec=now_usec()-start;
+	inst.steps++;
+	inst.total_usec+=usec;
+	if (usec>inst.max_usec)
+		inst.max_usec=usec;
+}
+
+// 自分のキューの前から、空なら他のキューの後ろから取る
+bool batch_runner::pop(int id,int *num)
+{
+	int count=(int)queues.size();
+	for (int i=0;i<count;i++){
+		work_queue *q=queues[(id+i)%count];
+		std::lock_guard<std::mutex> lk(q->lock);
+		if (q->items.empty())
+			continue;
+		if (i==0){
+			*num=q->items.front();
+			q->items.pop_front();
+		}
+		else{
+			*num=q->items.back();
+			q->items.pop_back();
+		}
+		return true;
+	}
+	return false;
+}
+
+void batch_runner::work(int id)
+{
+	int num;
+	while (pop(id,&num)){
+		run_one(num);
+		if (--remain==0){
+			std::lock_guard<std::mutex> lk(lock);
+			cond_done.notify_all();
+		}
+	}
+}
+
+void batch_runner::thread_proc(int id)
+{
+	int seen=0;
+	for (;;){
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			cond_start.wait(lk,[&]{ return b_quit||generation!=seen; });
+			if (b_quit)
+				return;
+			seen=generation;
+		}
+		work(id);
+	}
+}
+
+void batch_runner::step(const int *pads)
+{
+	int count=(int)insts.size(),threads=(int)queues.size();
+	if (count==0)
+		return;
+
+	double start=now_usec();
+	for (int i=0;i<count;i++)
+		insts[i].pad=pads?pads[i]:0;
+
+	// remain はキューに積む前に決めておく (前回の残りのスレッドがすぐ取っても数が合うように)
+	remain=count;
+	for (int t=0;t<threads;t++){
+		std::lock_guard<std::mutex> lk(queues[t]->lock);
+		for (int i=count*t/threads;i<count*(t+1)/threads;i++)
+			queues[t]->items.push_back(i);
+	}
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		generation++;
+	}
+	cond_start.notify_all();
+
+	work(0);
+	{
+		std::unique_lock<std::mutex> lk(lock);
+		cond_done.wait(lk,[&]{ return remain==0; });
+	}
+
+	frames+=count;
+	elapse_usec+=now_usec()-start;
+}
+
+double batch_runner::get_fps()
+{
+	return elapse_usec>0?frames*1000000.0/elapse_usec:0;
+}
+
+void batch_runner::clear_stats()
+{
+	frames=0;
+	elapse_usec=0;
+	for (size_t i=0;i<insts.size();i++){
+		insts[i].steps=0;
+		insts[i].total_usec=insts[i].max_usec=0;
+	}
+}
@@ -0,0 +1,109 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 複数の gb をまとめて 1 フレームずつ進める (強化学習の並列環境用)
+//
+// step() で全インスタンスに入力を渡し、スレッドプールで 1 フレームずつ進める。
+// 仕事はスレッドごとのキューに振り分け、自分の分が終わったスレッドは
+// 他のキューの後ろから取って進める (work stealing)。
+// 戻った後は get_frame (vframe) と get_observe (set_observe で指定した範囲) が読める。
+
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../gb_core/gb_types.h"
+
+class gb;
+class dmy_renderer;
+
+class batch_runner
+{
+public:
+	batch_runner(int threads); // 0 なら CPU の数
+	~batch_runner();
+
+	bool load_rom(const byte *dat,int size,int count); // count 台を作る (ROM は共有)
+	int get_count() { return (int)insts.size(); }
+	int get_threads() { return (int)queues.size(); }
+
+	void set_render(bool render); // false なら画面を作らない
+	void set_observe(int adr,int size); // 毎フレーム取り出すメモリの範囲を足す
+	void clear_observe() { ranges.clear(); obs_size=0; }
+
+	void step(const int *pads); // pads は get_count() 個
+	void reset(int num); // 作った直後の状態に戻す
+
+	gb *get_gb(int num) { return insts[num].ref; }
+	const word *get_frame(int num); // 160*144 (RGB555)
+	const byte *get_observe(int num) { return insts[num].obs.empty()?NULL:&insts[num].obs[0]; }
+	int get_observe_size() { return obs_size; }
+
+	// 統計
+	double get_fps(); // 全インスタンスを合わせた毎秒のフレーム数
+	double get_latency(int num) { return insts[num].steps?insts[num].total_usec/insts[num].steps:0; } // 1 フレームの平均 (usec)
+	double get_max_latency(int num) { return insts[num].max_usec; }
+	void clear_stats();
+
+private:
+	struct instance{
+		gb *ref;
+		dmy_renderer *render;
+		int pad;
+		std::vector<byte> obs;
+		long long steps;
+		double total_usec,max_usec;
+	};
+	struct work_queue{
+		std::mutex lock;
+		std::deque<int> items;
+	};
+
+	void run_one(int num);
+	bool pop(int id,int *num);
+	void work(int id);
+	void thread_proc(int id);
+	void release();
+
+	std::vector<instance> insts;
+	std::vector<byte> start_state;
+	std::vector<std::pair<int,int> > ranges;
+	int obs_size;
+	bool b_render;
+
+	std::vector<work_queue*> queues;
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable cond_start,cond_done;
+	int generation;
+	std::atomic<int> remain;
+	bool b_quit;
+
+	long long frames;
+	double elapse_usec;
+};
+
+#endif
@@ -0,0 +1,211 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ベンチマーク (TGB_BENCH を定義してビルドする)
+//
+// tgb_bench [-f frames] [-s name] [-o out.json]
+// -f : 1 つのシナリオで進めるフレーム数 (既定 3000)
+// -s : 名前にこの文字列を含むシナリオだけ
+// -o : 結果の JSON の書き出し先 (無ければ標準出力)
+//
+// 各シナリオは 2 回動かす。1 回目は計測なしで fps を、2 回目は区間ごとの時間を取る。
+// どちらも毎フレーム音を作って画面を web_renderer に渡し、
+// STATE_INTERVAL フレームごとにステートの保存と復元を 1 往復する。
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "bench_roms.h"
+#include "../gb_core/gb.h"
+#include "../gb_core/bench.h"
+#include "../web_ui/web_renderer.h"
+
+#define FRAMES_PER_SECOND (4194304.0/70224.0)
+#define STATE_INTERVAL 60
+
+extern "C" void jsLog(const char *) {}
+
+struct bench_result{
+	int frames;
+	double sec; // 計測なしの時間
+	double part_sec[BENCH_COUNT]; // 計測ありの区間ごと
+	double total_sec; // 計測ありの全体
+	int roundtrips;
+	int state_size;
+	long long samples;
+};
+
+static double now_sec()
+{
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// 1 回分を動かして経過時間を返す
+static double run_scenario(const bench_rom &rom,int frames,bench_result *res)
+{
+	web_renderer render;
+	gb g(&render,true,true);
+	g.load_rom((byte*)&rom.dat[0],(int)rom.dat.size(),NULL,0);
+
+	std::vector<byte> state(g.get_state_size());
+	short buf[2048*2];
+	res->roundtrips=0;
+	res->state_size=(int)state.size();
+	res->samples=0;
+
+	double start=now_sec();
+	for (int frame=0;frame<frames;frame++){
+		for (int line=0;line<154;line++)
+			g.run();
+		res->samples+=render.push_sound();
+		while (render.pull_sound(buf,2048)==2048);
+
+		if ((frame+1)%STATE_INTERVAL==0){
+			BENCH_SCOPE(BENCH_STATE);
+			g.save_state_mem(&state[0],(int)state.size());
+			g.restore_state_mem(&state[0],(int)state.size());
+			res->roundtrips++;
+		}
+	}
+	return now_sec()-start;
+}
+
+static void bench(const bench_rom &rom,int frames,bench_result *res)
+{
+	res->frames=frames;
+	res->sec=run_scenario(rom,frames,res);
+
+	memset(bench_ticks,0,sizeof(bench_ticks));
+	bench_enable=true;
+	unsigned long long tick_start=bench_now();
+	res->total_sec=run_scenario(rom,frames,res);
+	unsigned long long ticks=bench_now()-tick_start;
+	bench_enable=false;
+
+	// rdtsc の値は全体の時間との比で秒にする
+	for (int i=0;i<BENCH_COUNT;i++)
+		res->part_sec[i]=ticks?res->total_sec*bench_ticks[i]/ticks:0;
+}
+
+static void write_part(FILE *file,const char *name,double sec,const bench_result &res,bool b_last=false)
+{
+	fprintf(file,"        \"%s\": {\"ms\": %.3f, \"us_per_frame\": %.3f, \"percent\": %.1f}%s\n",
+		name,sec*1000,sec*1000000/res.frames,res.total_sec>0?sec*100/res.total_sec:0.0,b_last?"":",");
+}
+
+static void write_json(FILE *file,const std::vector<bench_rom> &roms,const std::vector<bench_result> &results)
+{
+	fprintf(file,"{\n");
+#if defined(__x86_64__)||defined(__i386__)
+	fprintf(file,"  \"tick_source\": \"rdtsc\",\n");
+#else
+	fprintf(file,"  \"tick_source\": \"steady_clock\",\n");
+#endif
+	fprintf(file,"  \"state_interval\": %d,\n",STATE_INTERVAL);
+	fprintf(file,"  \"scenarios\": [\n");
+	for (size_t i=0;i<results.size();i++){
+		const bench_result &res=results[i];
+		double fps=res.sec>0?res.frames/res.sec:0;
+		double other=res.total_sec;
+		for (int j=0;j<BENCH_COUNT;j++)
+			other-=res.part_sec[j];
+
+		fprintf(file,"    {\n");
+		fprintf(file,"      \"name\": \"%s\",\n",roms[i].name);
+		fprintf(file,"      \"desc\": \"%s\",\n",roms[i].desc);
+		fprintf(file,"      \"frames\": %d,\n",res.frames);
+		fprintf(file,"      \"seconds\": %.6f,\n",res.sec);
+		fprintf(file,"      \"fps\": %.1f,\n",fps);
+		fprintf(file,"      \"speed\": %.2f,\n",fps/FRAMES_PER_SECOND);
+		fprintf(file,"      \"us_per_frame\": %.3f,\n",res.sec*1000000/res.frames);
+		fprintf(file,"      \"samples\": %lld,\n",res.samples);
+		fprintf(file,"      \"state_size\": %d,\n",res.state_size);
+		fprintf(file,"      \"state_roundtrips\": %d,\n",res.roundtrips);
+		fprintf(file,"      \"profiled_seconds\": %.6f,\n",res.total_sec);
+		fprintf(file,"      \"parts\": {\n");
+		write_part(file,"cpu_exec",res.part_sec[BENCH_CPU],res);
+		write_part(file,"lcd_render",res.part_sec[BENCH_LCD],res);
+		write_part(file,"apu_render",res.part_sec[BENCH_SOUND],res);
+		write_part(file,"render_screen",res.part_sec[BENCH_SCREEN],res);
+		write_part(file,"state_roundtrip",res.part_sec[BENCH_STATE],res);
+		write_part(file,"other",other>0?other:0,res,true);
+		fprintf(file,"      }\n");
+		fprintf(file,"    }%s\n",i+1<results.size()?",":"");
+	}
+	fprintf(file,"  ]\n");
+	fprintf(file,"}\n");
+}
+
+static void usage()
+{
+	fprintf(stderr,"usage: tgb_bench [-f frames] [-s name] [-o out.json]\n");
+}
+
+int main(int argc,char **argv)
+{
+	int frames=3000;
+	const char *filter=NULL,*out_path=NULL;
+	for (int i=1;i<argc;i++){
+		if (!strcmp(argv[i],"-f")&&i+1<argc)
+			frames=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"-s")&&i+1<argc)
+			filter=argv[++i];
+		else if (!strcmp(argv[i],"-o")&&i+1<argc)
+			out_path=argv[++i];
+		else{
+			usage();
+			return 2;
+		}
+	}
+	if (frames<=0){
+		usage();
+		return 2;
+	}
+
+	std::vector<bench_rom> all,roms;
+	make_bench_roms(all);
+	for (size_t i=0;i<all.size();i++)
+		if (!filter||strstr(all[i].name,filter))
+			roms.push_back(all[i]);
+	if (roms.empty()){
+		fprintf(stderr,"no scenario matches %s\n",filter);
+		return 2;
+	}
+
+	std::vector<bench_result> results(roms.size());
+	for (size_t i=0;i<roms.size();i++){
+		bench(roms[i],frames,&results[i]);
+		fprintf(stderr,"%-8s : %.0f fps\n",roms[i].name,results[i].frames/results[i].sec);
+	}
+
+	FILE *file=out_path?fopen(out_path,"w"):stdout;
+	if (!file){
+		fprintf(stderr,"cannot write %s\n",out_path);
+		return 2;
+	}
+	write_json(file,roms,results);
+	if (out_path)
+		fclose(file);
+	return 0;
+}
@@ -0,0 +1,346 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ベンチマーク用の ROM を作る
+
+#include "bench_roms.h"
+#include <map>
+#include <string>
+
+// 小さなアセンブラ (命令はバイト列で書き、ジャンプ先だけラベルで解決する)
+class rom_builder
+{
+public:
+	rom_builder(int size) : rom(size,0xFF),pc(0) {}
+
+	void org(int adr) { pc=adr; }
+	void label(const char *name) { labels[name]=pc; }
+	void db(std::initializer_list<int> dat) { for (int d : dat) rom[pc++]=(byte)d; }
+	void dw(int op,int val) { db({op,val&0xFF,(val>>8)&0xFF}); }
+	void jr(int op,const char *name) { db({op,0}); fixes.push_back(fixup(pc-1,name,true)); } // JR cc
+	void jp(int op,const char *name) { db({op,0,0}); fixes.push_back(fixup(pc-2,name,false)); } // JP/CALL cc
+
+	void ldh(int reg,int val) { db({0x3E,val,0xE0,reg&0xFF}); } // LD A,val / LDH (reg),A
+
+	std::vector<byte> finish(const char *title,int cgb,int type,int size_code)
+	{
+		for (size_t i=0;i<fixes.size();i++){
+			int to=labels[fixes[i].name];
+			if (fixes[i].rel)
+				rom[fixes[i].adr]=(byte)(to-(fixes[i].adr+1));
+			else{
+				rom[fixes[i].adr]=to&0xFF;
+				rom[fixes[i].adr+1]=to>>8;
+			}
+		}
+
+		for (int i=0x134;i<0x143;i++)
+			rom[i]=0;
+		for (int i=0;title[i]&&i<11;i++)
+			rom[0x134+i]=title[i];
+		rom[0x143]=cgb;
+		rom[0x147]=type;
+		rom[0x148]=size_code;
+		rom[0x149]=0;
+		rom[0x14A]=1;
+		rom[0x14B]=0x33;
+
+		int sum=0;
+		for (int i=0x134;i<0x14D;i++)
+			sum=sum-rom[i]-1;
+		rom[0x14D]=sum&0xFF;
+		return rom;
+	}
+
+private:
+	struct fixup{
+		int adr;
+		std::string name;
+		bool rel;
+		fixup(int a,const char *n,bool r) : adr(a),name(n),rel(r) {}
+	};
+
+	std::vector<byte> rom;
+	int pc;
+	std::map<std::string,int> labels;
+	std::vector<fixup> fixes;
+};
+
+// 割り込みベクタ、ヘッダの入口、共通のサブルーチン
+static void put_common(rom_builder &r)
+{
+	r.org(0x40); r.jp(0xC3,"vblank");
+	r.org(0x48); r.jp(0xC3,"stat");
+	r.org(0x50); r.db({0xD9});
+	r.org(0x58); r.db({0xD9});
+	r.org(0x60); r.db({0xD9});
+	r.org(0x100); r.db({0x00}); r.jp(0xC3,"start");
+
+	r.org(0x150);
+
+	// HL から BC バイトをアドレスから作った模様で埋める (タイル)
+	r.label("fill_pat");
+	r.db({0x7D,0xAC,0x0F,0x22,0x0B,0x78,0xB1}); // LD A,L / XOR H / RRCA / LD (HL+),A / DEC BC / LD A,B / OR C
+	r.jr(0x20,"fill_pat");
+	r.db({0xC9});
+
+	// HL から BC バイトを下位アドレスで埋める (マップ)
+	r.label("fill_idx");
+	r.db({0x7D,0x22,0x0B,0x78,0xB1}); // LD A,L / LD (HL+),A / DEC BC / LD A,B / OR C
+	r.jr(0x20,"fill_idx");
+	r.db({0xC9});
+
+	// HL から BC バイトを属性 (パレット番号と反転) で埋める
+	r.label("fill_attr");
+	r.db({0x7D,0xE6,0x27,0x22,0x0B,0x78,0xB1}); // LD A,L / AND $27 / LD (HL+),A / DEC BC / LD A,B / OR C
+	r.jr(0x20,"fill_attr");
+	r.db({0xC9});
+
+	// C100 に 40 個のスプライトを並べる (OAM DMA の元)
+	r.label("init_oam");
+	r.dw(0x21,0xC100); // LD HL,$C100
+	r.db({0x0E,0x00}); // LD C,0
+	r.label("init_oam_loop");
+	r.db({0x79,0x87,0x87,0xC6,0x10,0x22}); // LD A,C / ADD A,A / ADD A,A / ADD A,16 / LD (HL+),A  (Y)
+	r.db({0x79,0x87,0x81,0xC6,0x08,0x22}); // LD A,C / ADD A,A / ADD A,C / ADD A,8 / LD (HL+),A  (X)
+	r.db({0x79,0x22}); // LD A,C / LD (HL+),A  (タイル)
+	r.db({0x79,0xE6,0x27,0x22}); // LD A,C / AND $27 / LD (HL+),A  (属性)
+	r.db({0x0C,0x79,0xFE,40}); // INC C / LD A,C / CP 40
+	r.jr(0x20,"init_oam_loop");
+	r.db({0xC9});
+
+	// WRAM の C000 から BC バイトを読んで書き戻す計算
+	r.label("calc");
+	r.dw(0x21,0xC000); // LD HL,$C000
+	r.label("calc_loop");
+	r.db({0x7E,0x85,0xAC,0x0F,0x22,0x0B,0x78,0xB1}); // LD A,(HL) / ADD A,L / XOR H / RRCA / LD (HL+),A / DEC BC / LD A,B / OR C
+	r.jr(0x20,"calc_loop");
+	r.db({0xC9});
+
+	// 入口 : VBlank を待って LCD を止め、VRAM とパレットを埋める
+	r.label("start");
+	r.db({0xF3}); // DI
+	r.dw(0x31,0xFFFE); // LD SP,$FFFE
+	r.label("wait_vblank");
+	r.db({0xF0,0x44,0xFE,144}); // LDH A,(LY) / CP 144
+	r.jr(0x38,"wait_vblank");
+	r.ldh(0x40,0x00);
+	r.dw(0x21,0x8000); r.dw(0x01,0x1800); r.jp(0xCD,"fill_pat");
+	r.dw(0x21,0x9800); r.dw(0x01,0x0800); r.jp(0xCD,"fill_idx");
+	r.jp(0xCD,"init_oam");
+	r.ldh(0x47,0xE4);
+	r.ldh(0x48,0xD2);
+	r.ldh(0x49,0x1B);
+}
+
+// 割り込みを許可して LCD を入れる
+static void put_enable(rom_builder &r,int lcdc,int ie)
+{
+	r.ldh(0x40,lcdc);
+	r.ldh(0xFF,ie);
+	r.ldh(0x0F,0);
+	r.db({0xFB}); // EI
+}
+
+// CPU : WRAM の計算、MBC1 のバンク切り替えとバンク領域の読み出し、CB 命令
+static std::vector<byte> make_dmg_cpu()
+{
+	rom_builder r(0x10000);
+	put_common(r);
+	put_enable(r,0x91,0x01);
+
+	r.label("main");
+	r.dw(0x01,0x1000); r.jp(0xCD,"calc");
+
+	r.db({0x16,0x01}); // LD D,1
+	r.label("bank_loop");
+	r.db({0x7A,0xEA,0x00,0x20}); // LD A,D / LD ($2000),A
+	r.dw(0x21,0x4000); r.db({0x06,0x00}); // LD HL,$4000 / LD B,0
+	r.label("bank_read");
+	r.db({0x2A,0x83,0x5F,0x05}); // LD A,(HL+) / ADD A,E / LD E,A / DEC B
+	r.jr(0x20,"bank_read");
+	r.db({0x14,0x7A,0xFE,0x04}); // INC D / LD A,D / CP 4
+	r.jr(0x20,"bank_loop");
+
+	r.db({0x16,0x00}); // LD D,0
+	r.label("bit_loop");
+	r.db({0x7A,0x07,0xCB,0x37,0xCB,0x3F,0xCB,0x5F}); // LD A,D / RLCA / SWAP A / SRL A / BIT 3,A
+	r.jr(0x28,"bit_skip");
+	r.db({0x2F}); // CPL
+	r.label("bit_skip");
+	r.db({0xAB,0x5F,0xCB,0x13,0x15}); // XOR E / LD E,A / RL E / DEC D
+	r.jr(0x20,"bit_loop");
+	r.jp(0xC3,"main");
+
+	r.label("vblank");
+	r.db({0xF5,0xF0,0x43,0x3C,0xE0,0x43,0xF1,0xD9}); // PUSH AF / SCX++ / POP AF / RETI
+	r.label("stat");
+	r.db({0xD9});
+
+	// バンク 1-3 は読み出し用のデータ
+	std::vector<byte> rom=r.finish("BENCH CPU",0x00,0x01,0x01);
+	for (int i=0x4000;i<0x10000;i++)
+		rom[i]=(byte)(i*7+(i>>8));
+	return rom;
+}
+
+// LCD : BG、ウィンドウ、40 個のスプライト、LYC 割り込みでのスクロール
+static std::vector<byte> make_dmg_lcd()
+{
+	rom_builder r(0x8000);
+	put_common(r);
+	r.ldh(0x4A,0x60); // WY
+	r.ldh(0x4B,0x50); // WX
+	r.ldh(0x45,0x08); // LYC
+	r.ldh(0x41,0x40); // LYC 割り込み
+	put_enable(r,0xF3,0x03);
+
+	// スプライトを横に動かして VBlank を待つ
+	r.label("main");
+	r.dw(0x21,0xC101); r.db({0x06,40}); // LD HL,$C101 / LD B,40
+	r.label("move");
+	r.db({0x34,0x23,0x23,0x23,0x23,0x05}); // INC (HL) / INC HL x4 / DEC B
+	r.jr(0x20,"move");
+	r.db({0x76,0x00}); // HALT / NOP
+	r.jp(0xC3,"main");
+
+	r.label("vblank");
+	r.db({0xF5}); // PUSH AF
+	r.ldh(0x46,0xC1); // OAM DMA
+	r.db({0xF0,0x43,0x3C,0xE0,0x43}); // SCX++
+	r.ldh(0x42,0x00); // SCY
+	r.ldh(0x45,0x08);
+	r.db({0xF1,0xD9}); // POP AF / RETI
+
+	// 16 ラインごとに SCY をずらす
+	r.label("stat");
+	r.db({0xF5,0xF0,0x42,0xC6,0x03,0xE0,0x42}); // PUSH AF / SCY+=3
+	r.db({0xF0,0x45,0xC6,0x10,0xE0,0x45}); // LYC+=16
+	r.db({0xF1,0xD9}); // POP AF / RETI
+
+	return r.finish("BENCH LCD",0x00,0x00,0x00);
+}
+
+// APU : 4 チャンネルを鳴らし、毎フレーム周波数を変えて鳴らし直す
+static std::vector<byte> make_dmg_apu()
+{
+	rom_builder r(0x8000);
+	put_common(r);
+	r.ldh(0x26,0x80);
+	r.ldh(0x24,0x77);
+	r.ldh(0x25,0xFF);
+
+	// 波形メモリ
+	r.dw(0x21,0xFF30); r.db({0x06,16,0x3E,0x01}); // LD HL,$FF30 / LD B,16 / LD A,1
+	r.label("wave");
+	r.db({0x22,0xC6,0x22,0x05}); // LD (HL+),A / ADD A,$22 / DEC B
+	r.jr(0x20,"wave");
+
+	r.ldh(0x10,0x15); r.ldh(0x11,0x80); r.ldh(0x12,0xF3); r.ldh(0x13,0x00); r.ldh(0x14,0x87);
+	r.ldh(0x16,0x40); r.ldh(0x17,0xF0); r.ldh(0x18,0x00); r.ldh(0x19,0x86);
+	r.ldh(0x1A,0x80); r.ldh(0x1B,0x00); r.ldh(0x1C,0x20); r.ldh(0x1D,0x00); r.ldh(0x1E,0x87);
+	r.ldh(0x20,0x00); r.ldh(0x21,0xF1); r.ldh(0x22,0x55); r.ldh(0x23,0x80);
+	put_enable(r,0x91,0x01);
+
+	r.label("main");
+	r.db({0x76,0x00}); // HALT / NOP
+	r.jp(0xC3,"main");
+
+	r.label("vblank");
+	r.db({0xF5}); // PUSH AF
+	r.db({0xF0,0x80,0x3C,0xE0,0x80}); // ($FF80)++
+	r.db({0xE0,0x13}); r.ldh(0x14,0x87); // SQ1
+	r.db({0xF0,0x80,0x2F,0xE0,0x18}); r.ldh(0x19,0x86); // SQ2
+	r.db({0xF0,0x80,0xE6,0x07,0xF6,0x50,0xE0,0x22}); r.ldh(0x23,0x80); // NOI
+	r.db({0xF0,0x80,0xE6,0x0F}); // 16 フレームごとに WAV
+	r.jr(0x20,"vblank_end");
+	r.db({0xF0,0x80,0xE0,0x1D}); r.ldh(0x1E,0x87);
+	r.label("vblank_end");
+	r.db({0xF1,0xD9}); // POP AF / RETI
+	r.label("stat");
+	r.db({0xD9});
+
+	return r.finish("BENCH APU",0x00,0x00,0x00);
+}
+
+// CGB : 倍速、パレット、VRAM バンク 1 の属性、HBlank DMA、WRAM バンク切り替え
+static std::vector<byte> make_cgb_mix()
+{
+	rom_builder r(0x8000);
+	put_common(r);
+
+	r.ldh(0x4D,0x01); r.db({0x10,0x00}); // KEY1 / STOP
+
+	r.ldh(0x68,0x80); r.db({0x06,64,0xAF}); // BCPS / LD B,64 / XOR A
+	r.label("bg_pal");
+	r.db({0xE0,0x69,0xC6,0x25,0x05}); // LDH (BCPD),A / ADD A,$25 / DEC B
+	r.jr(0x20,"bg_pal");
+	r.ldh(0x6A,0x80); r.db({0x06,64,0xAF}); // OCPS / LD B,64 / XOR A
+	r.label("obj_pal");
+	r.db({0xE0,0x6B,0xC6,0x13,0x05}); // LDH (OCPD),A / ADD A,$13 / DEC B
+	r.jr(0x20,"obj_pal");
+
+	r.ldh(0x4F,0x01);
+	r.dw(0x21,0x8000); r.dw(0x01,0x1800); r.jp(0xCD,"fill_pat");
+	r.dw(0x21,0x9800); r.dw(0x01,0x0800); r.jp(0xCD,"fill_attr");
+	r.ldh(0x4F,0x00);
+
+	r.ldh(0x4A,0x70); // WY
+	r.ldh(0x4B,0x30); // WX
+	put_enable(r,0xF3,0x01);
+
+	r.label("main");
+	r.dw(0x01,0x0800); r.jp(0xCD,"calc");
+	r.db({0x16,0x01}); // LD D,1
+	r.label("wram_loop");
+	r.db({0x7A,0xE0,0x70}); // LD A,D / LDH (SVBK),A
+	r.dw(0x21,0xD000); r.db({0x06,0x00}); // LD HL,$D000 / LD B,0
+	r.label("wram_write");
+	r.db({0x7D,0xAA,0x22,0x05}); // LD A,L / XOR D / LD (HL+),A / DEC B
+	r.jr(0x20,"wram_write");
+	r.db({0x14,0x7A,0xFE,0x08}); // INC D / LD A,D / CP 8
+	r.jr(0x20,"wram_loop");
+	r.jp(0xC3,"main");
+
+	// 前の HBlank DMA が終わっていれば C000-C7FF を 8800 へ送り直す
+	r.label("vblank");
+	r.db({0xF5,0xF0,0x55,0xFE,0xFF}); // PUSH AF / LDH A,(HDMA5) / CP $FF
+	r.jr(0x20,"vblank_dma");
+	r.ldh(0x51,0xC0); r.ldh(0x52,0x00); r.ldh(0x53,0x08); r.ldh(0x54,0x00); r.ldh(0x55,0xFF);
+	r.label("vblank_dma");
+	r.ldh(0x46,0xC1); // OAM DMA
+	r.db({0xF0,0x43,0x3C,0xE0,0x43}); // SCX++
+	r.db({0xF1,0xD9}); // POP AF / RETI
+	r.label("stat");
+	r.db({0xD9});
+
+	return r.finish("BENCH CGB",0x80,0x00,0x00);
+}
+
+void make_bench_roms(std::vector<bench_rom> &out)
+{
+	bench_rom roms[]={
+		{"dmg_cpu","DMG, CPU loops and MBC1 bank switching",make_dmg_cpu()},
+		{"dmg_lcd","DMG, BG + window + 40 sprites with mid-frame scroll",make_dmg_lcd()},
+		{"dmg_apu","DMG, all four sound channels retriggered every frame",make_dmg_apu()},
+		{"cgb_mix","CGB double speed, palettes, HBlank DMA, WRAM banks",make_cgb_mix()},
+	};
+	out.assign(roms,roms+sizeof(roms)/sizeof(roms[0]));
+}
@@ -0,0 +1,41 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ベンチマーク用の ROM を作る
+//
+// リポジトリに ROM を置かなくて済むように、小さなプログラムをその場で組み立てる。
+// どれも電源を入れたら止まらずに同じ処理を繰り返す。
+
+#ifndef BENCH_ROMS_H
+#define BENCH_ROMS_H
+
+#include <vector>
+
+#include "../gb_core/gb_types.h"
+
+struct bench_rom{
+	const char *name;
+	const char *desc;
+	std::vector<byte> dat;
+};
+
+void make_bench_roms(std::vector<bench_rom> &out);
+
+#endif
@@ -0,0 +1,39 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ネイティブのツールで使うファイル読み込み
+
+#include "file_util.h"
+#include <stdio.h>
+
+bool read_file(const char *path,std::vector<byte> &out)
+{
+	FILE *file=fopen(path,"rb");
+	if (!file)
+		return false;
+
+	byte tmp[0x10000];
+	int size;
+	out.clear();
+	while ((size=(int)fread(tmp,1,sizeof(tmp),file))>0)
+		out.insert(out.end(),tmp,tmp+size);
+	fclose(file);
+	return true;
+}
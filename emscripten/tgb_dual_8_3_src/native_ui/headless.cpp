@@ -0,0 +1,338 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 画面も音も出さずに ROM を動かす (サーバーでの実行や perf での計測用)
+//
+// tgb_headless <rom> [-f frames] [-u adr=val] [-m movie] [-o out.png|out.ppm] [-a] [-g dmg|cgb]
+//                    [-p report.txt] [-y rom.sym] [-t trace.bin]
+// -f : 進めるフレーム数 (0 ならムービーの終わりか -u の条件まで)
+// -u : フレームの終わりに adr (16 進) の値が val (16 進) になったら止める (I/O の FF00-FF7F は見られない)
+// -m : ムービーの入力で動かす (-f が無ければ最後まで)
+// -o : 最後の画面を PNG か PPM (拡張子で決める) で書き出す
+// -a : 音も毎フレーム作る (捨てる)
+// -g : GB/GBC を決める (無ければ ROM のヘッダに従う)
+// -p : PC のサンプリング結果を書き出す (TGB_PROFILE でビルドした時だけ)
+// -y : -p のレポートにルーチン名を付ける .sym
+// -t : 最後の TRACE_DEFAULT_RECORDS 命令のトレースを書き出す (tgb_trace で読む)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "../gb_core/gb.h"
+#include "../gb_core/movie.h"
+#include "../gb_core/profiler.h"
+#include "../gb_core/trace.h"
+#include "../web_ui/dmy_renderer.h"
+#include "file_util.h"
+
+#define FRAMES_PER_SECOND (4194304.0/70224.0)
+
+// vframe (xBBBBBGG GGGRRRRR) を RGB 24bit に
+static void get_rgb(gb *g,std::vector<byte> &out)
+{
+	word *src=g->get_vframe();
+	out.resize(160*144*3);
+	for (int i=0;i<160*144;i++){
+		int r=src[i]&0x1f,gr=(src[i]>>5)&0x1f,b=(src[i]>>10)&0x1f;
+		out[i*3+0]=(r<<3)|(r>>2);
+		out[i*3+1]=(gr<<3)|(gr>>2);
+		out[i*3+2]=(b<<3)|(b>>2);
+	}
+}
+
+static bool write_ppm(const char *path,std::vector<byte> &rgb)
+{
+	FILE *file=fopen(path,"wb");
+	if (!file)
+		return false;
+	fprintf(file,"P6\n160 144\n255\n");
+	fwrite(&rgb[0],1,rgb.size(),file);
+	bool ret=!ferror(file);
+	fclose(file);
+	return ret;
+}
+
+//--------------------------------------------------
+// PNG (zlib を使わないので無圧縮のブロックで書く)
+
+static dword crc32(const byte *dat,int size,dword crc=0)
+{
+	static dword tbl[256];
+	if (!tbl[1]){
+		for (dword i=0;i<256;i++){
+			dword c=i;
+			for (int j=0;j<8;j++)
+				c=(c&1)?0xEDB88320^(c>>1):c>>1;
+			tbl[i]=c;
+		}
+	}
+	crc=~crc;
+	for (int i=0;i<size;i++)
+		crc=tbl[(crc^dat[i])&0xff]^(crc>>8);
+	return ~crc;
+}
+
+static void put32(std::vector<byte> &out,dword dat)
+{
+	out.push_back(dat>>24);
+	out.push_back(dat>>16);
+	out.push_back(dat>>8);
+	out.push_back(dat);
+}
+
+static void put_chunk(std::vector<byte> &out,const char *type,const std::vector<byte> &dat)
+{
+	put32(out,(dword)dat.size());
+	size_t top=out.size();
+	out.insert(out.end(),type,type+4);
+	out.insert(out.end(),dat.begin(),dat.end());
+	put32(out,crc32(&out[top],(int)(out.size()-top)));
+}
+
+static bool write_png(const char *path,std::vector<byte> &rgb)
+{
+	// 各行の頭にフィルタ (0) を付ける
+	std::vector<byte> raw;
+	for (int y=0;y<144;y++){
+		raw.push_back(0);
+		raw.insert(raw.end(),rgb.begin()+y*160*3,rgb.begin()+(y+1)*160*3);
+	}
+
+	std::vector<byte> z;
+	z.push_back(0x78);
+	z.push_back(0x01);
+	for (size_t pos=0;pos<raw.size();pos+=0xffff){
+		int len=(int)((raw.size()-pos<0xffff)?raw.size()-pos:0xffff);
+		z.push_back((pos+len==raw.size())?1:0);
+		z.push_back(len&0xff);
+		z.push_back(len>>8);
+		z.push_back(~len&0xff);
+		z.push_back((~len>>8)&0xff);
+		z.insert(z.end(),raw.begin()+pos,raw.begin()+pos+len);
+	}
+	dword a=1,b=0;
+	for (size_t i=0;i<raw.size();i++){
+		a=(a+raw[i])%65521;
+		b=(b+a)%65521;
+	}
+	put32(z,(b<<16)|a);
+
+	std::vector<byte> head,out;
+	put32(head,160);
+	put32(head,144);
+	head.push_back(8); // 8bit
+	head.push_back(2); // RGB
+	head.push_back(0);
+	head.push_back(0);
+	head.push_back(0);
+
+	static const byte sig[]={0x89,'P','N','G','\r','\n',0x1a,'\n'};
+	out.insert(out.end(),sig,sig+8);
+	put_chunk(out,"IHDR",head);
+	put_chunk(out,"IDAT",z);
+	put_chunk(out,"IEND",std::vector<byte>());
+
+	FILE *file=fopen(path,"wb");
+	if (!file)
+		return false;
+	fwrite(&out[0],1,out.size(),file);
+	bool ret=!ferror(file);
+	fclose(file);
+	return ret;
+}
+
+static void usage()
+{
+	fprintf(stderr,"usage: tgb_headless <rom> [-f frames] [-u adr=val] [-m movie] [-o out.png|out.ppm] [-a] [-g dmg|cgb] [-p report.txt] [-y rom.sym] [-t trace.bin]\n");
+}
+
+int main(int argc,char **argv)
+{
+	if (argc<2){
+		usage();
+		return 2;
+	}
+
+	int frames=-1,until_adr=-1,until_val=0,gb_type=0;
+	const char *movie_path=NULL,*out_path=NULL,*prof_path=NULL,*sym_path=NULL,*trace_path=NULL;
+	bool b_sound=false;
+	for (int i=2;i<argc;i++){
+		if (!strcmp(argv[i],"-f")&&i+1<argc)
+			frames=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"-u")&&i+1<argc){
+			char *end;
+			until_adr=(int)strtol(argv[++i],&end,16)&0xffff;
+			if (*end!='='){
+				usage();
+				return 2;
+			}
+			until_val=(int)strtol(end+1,NULL,16)&0xff;
+			if (until_adr>=0xFF00&&until_adr<0xFF80){ // 読むと副作用がある
+				fprintf(stderr,"-u cannot watch I/O registers (FF00-FF7F)\n");
+				return 2;
+			}
+		}
+		else if (!strcmp(argv[i],"-m")&&i+1<argc)
+			movie_path=argv[++i];
+		else if (!strcmp(argv[i],"-o")&&i+1<argc)
+			out_path=argv[++i];
+		else if (!strcmp(argv[i],"-a"))
+			b_sound=true;
+		else if (!strcmp(argv[i],"-p")&&i+1<argc)
+			prof_path=argv[++i];
+		else if (!strcmp(argv[i],"-y")&&i+1<argc)
+			sym_path=argv[++i];
+		else if (!strcmp(argv[i],"-t")&&i+1<argc)
+			trace_path=argv[++i];
+		else if (!strcmp(argv[i],"-g")&&i+1<argc){
+			i++;
+			gb_type=!strcmp(argv[i],"dmg")?1:!strcmp(argv[i],"cgb")?3:-1;
+			if (gb_type<0){
+				usage();
+				return 2;
+			}
+		}
+		else{
+			usage();
+			return 2;
+		}
+	}
+	if (frames<0)
+		frames=(movie_path||until_adr>=0)?0:600;
+	else if (frames==0&&!movie_path&&until_adr<0){ // 止まる所が無い
+		fprintf(stderr,"-f 0 needs -m or -u\n");
+		return 2;
+	}
+
+	std::vector<byte> rom_dat;
+	if (!read_file(argv[1],rom_dat)||rom_dat.size()<0x150){
+		fprintf(stderr,"cannot read %s\n",argv[1]);
+		return 2;
+	}
+	if (gb_type==1)
+		rom_dat[0x143]&=0x7f;
+	else if (gb_type==3)
+		rom_dat[0x143]|=0x80;
+
+	movie mov;
+	if (movie_path){
+		FILE *file=fopen(movie_path,"rb");
+		bool b_movie=file&&mov.load(file);
+		if (file)
+			fclose(file);
+		if (!b_movie){
+			fprintf(stderr,"cannot read %s\n",movie_path);
+			return 2;
+		}
+	}
+
+	dmy_renderer render;
+	gb g(&render,true,true);
+	if (!g.load_rom(&rom_dat[0],(int)rom_dat.size(),NULL,0)){
+		fprintf(stderr,"cannot load %s\n",argv[1]);
+		return 2;
+	}
+	g.get_apu()->set_sound_enable(b_sound);
+	if (movie_path){
+		render.set_fixed_time(mov.get_rtc_base());
+		render.set_timer_state(mov.get_rtc_offset());
+		if (!mov.start_play(&g)){
+			fprintf(stderr,"%s was not recorded with this ROM\n",movie_path);
+			return 2;
+		}
+	}
+	if (prof_path){
+		g.set_profile(PROFILE_DEFAULT_INTERVAL);
+		if (!g.get_profiler()){
+			fprintf(stderr,"-p needs a build with TGB_PROFILE\n");
+			return 2;
+		}
+		if (sym_path){
+			std::vector<byte> sym;
+			if (!read_file(sym_path,sym)){
+				fprintf(stderr,"cannot read %s\n",sym_path);
+				return 2;
+			}
+			sym.push_back(0);
+			g.get_profiler()->load_sym((const char*)&sym[0]);
+		}
+	}
+	if (trace_path)
+		g.get_cpu()->set_trace(true);
+	// 最後の画面が要らなければ描画もしない
+	g.set_lcd_enable(out_path!=NULL);
+
+	apu_snd *snd=g.get_apu()->get_renderer();
+	short buf[2048*2];
+	const char *reason="frames";
+	int frame=0;
+	auto start=std::chrono::steady_clock::now();
+	for (;;){
+		if (frames>0&&frame>=frames)
+			break;
+		if (movie_path){
+			int pad;
+			if (!mov.next(&pad)){
+				reason="movie end";
+				break;
+			}
+			render.set_pad(pad);
+		}
+		for (int line=0;line<154;line++)
+			g.run();
+		if (b_sound)
+			snd->render_pending(buf,2048);
+		frame++;
+		if (until_adr>=0&&g.get_cpu()->read_direct(until_adr)==until_val){
+			reason="condition";
+			break;
+		}
+	}
+	double sec=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+	double fps=frame/(sec>0?sec:1e-9);
+	printf("%d frames (%s) in %.3f s : %.0f fps, %.1fx, %.2f us/frame\n",
+		frame,reason,sec,fps,fps/FRAMES_PER_SECOND,frame?sec*1000000/frame:0.0);
+
+	if (prof_path&&!g.get_profiler()->save_report(prof_path,100)){
+		fprintf(stderr,"cannot write %s\n",prof_path);
+		return 2;
+	}
+
+	if (trace_path&&!g.get_cpu()->get_trace()->save(trace_path)){
+		fprintf(stderr,"cannot write %s\n",trace_path);
+		return 2;
+	}
+
+	if (out_path){
+		std::vector<byte> rgb;
+		get_rgb(&g,rgb);
+		size_t len=strlen(out_path);
+		bool b_ppm=len>4&&!strcmp(out_path+len-4,".ppm");
+		if (!(b_ppm?write_ppm(out_path,rgb):write_png(out_path,rgb))){
+			fprintf(stderr,"cannot write %s\n",out_path);
+			return 2;
+		}
+	}
+	return 0;
+}
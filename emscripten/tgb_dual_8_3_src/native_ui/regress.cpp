@@ -0,0 +1,342 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// ムービーを区間に分けて並列に再生する回帰テスト
+//
+// record : ムービーを頭から再生し、区切りのフレームでステートとハッシュを保存する
+// verify : 保存したステートから各区間を並列に再生し、区間の終わりのハッシュを比べる
+//
+// 区切りの 0 フレーム目はムービーの開始直後、最後は末尾のフレームになる。
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../gb_core/gb.h"
+#include "../gb_core/hash_log.h"
+#include "../gb_core/lz.h"
+#include "../gb_core/movie.h"
+#include "../web_ui/dmy_renderer.h"
+#include "file_util.h"
+
+// ファイルの形式 : "TGBP" , バージョン , 区切りの数 ,
+//                  [フレーム , RTC (cur_time) , ハッシュ (8*HASH_COUNT) , サイズ , ステート (lz_pack)]...
+#define SNAP_MAGIC 0x50424754 // "TGBP"
+#define SNAP_VERSION 1
+
+struct snapshot{
+	int frame;
+	int timer;
+	qword hash[HASH_COUNT];
+	std::vector<byte> state;
+};
+
+struct segment_result{
+	int part; // 違った場所 (HASH_XXX、ステートが読めない時は HASH_COUNT)、同じなら -1
+	bool b_start; // 区間の頭 (ステートを戻した直後) で違った
+	double msec;
+};
+
+static const char *part_name[HASH_COUNT]={"vframe","wram","vram","oam","sram","regs"};
+
+static int diff_part(const qword *a,const qword *b)
+{
+	for (int i=0;i<HASH_COUNT;i++)
+		if (a[i]!=b[i])
+			return i;
+	return -1;
+}
+
+static bool save_snapshots(const char *path,std::vector<snapshot> &snaps)
+{
+	FILE *file=fopen(path,"wb");
+	if (!file)
+		return false;
+
+	int head[]={SNAP_MAGIC,SNAP_VERSION,(int)snaps.size()};
+	fwrite(head,sizeof(int),3,file);
+	for (size_t i=0;i<snaps.size();i++){
+		int size=(int)snaps[i].state.size();
+		fwrite(&snaps[i].frame,sizeof(int),1,file);
+		fwrite(&snaps[i].timer,sizeof(int),1,file);
+		fwrite(snaps[i].hash,sizeof(qword),HASH_COUNT,file);
+		fwrite(&size,sizeof(int),1,file);
+		fwrite(&snaps[i].state[0],1,size,file);
+	}
+	bool ret=!ferror(file);
+	fclose(file);
+	return ret;
+}
+
+static bool load_snapshots(const char *path,std::vector<snapshot> &snaps)
+{
+	FILE *file=fopen(path,"rb");
+	if (!file)
+		return false;
+
+	int head[3];
+	bool ret=fread(head,sizeof(int),3,file)==3&&head[0]==SNAP_MAGIC&&head[1]==SNAP_VERSION&&head[2]>0;
+	if (ret)
+		snaps.resize(head[2]);
+	for (size_t i=0;ret&&i<snaps.size();i++){
+		int size;
+		ret=fread(&snaps[i].frame,sizeof(int),1,file)==1&&
+			fread(&snaps[i].timer,sizeof(int),1,file)==1&&
+			fread(snaps[i].hash,sizeof(qword),HASH_COUNT,file)==HASH_COUNT&&
+			fread(&size,sizeof(int),1,file)==1&&size>0;
+		if (ret){
+			snaps[i].state.resize(size);
+			ret=fread(&snaps[i].state[0],1,size,file)==(size_t)size;
+		}
+	}
+	fclose(file);
+	return ret;
+}
+
+// 区切りを "600,1200,..." から読む
+static void parse_frames(const char *str,std::vector<int> &out)
+{
+	while (*str){
+		char *end;
+		long frame=strtol(str,&end,10);
+		if (end==str)
+			break;
+		out.push_back((int)frame);
+		str=(*end==',')?end+1:end;
+	}
+}
+
+static void run_frames(gb *g,dmy_renderer *render,movie *mov,int from,int to)
+{
+	for (int frame=from;frame<to;frame++){
+		render->set_pad(mov->get_pad(frame));
+		for (int line=0;line<154;line++)
+			g->run();
+	}
+}
+
+static void take_snapshot(gb *g,dmy_renderer *render,int frame,snapshot &snap)
+{
+	std::vector<byte> raw(g->get_state_size());
+	g->save_state_mem(&raw[0],(int)raw.size());
+	lz_pack(&raw[0],(int)raw.size(),snap.state);
+	snap.frame=frame;
+	snap.timer=render->get_timer_state();
+	hash_log::calc(g,snap.hash);
+}
+
+static double now_msec()
+{
+	using namespace std::chrono;
+	return duration<double,std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static int record(gb *g,dmy_renderer *render,movie *mov,const char *path,std::vector<int> &frames)
+{
+	int length=mov->get_length();
+	frames.push_back(0);
+	frames.push_back(length);
+	std::sort(frames.begin(),frames.end());
+	frames.erase(std::unique(frames.begin(),frames.end()),frames.end());
+	while (!frames.empty()&&frames.back()>length)
+		frames.pop_back();
+	while (!frames.empty()&&frames.front()<0)
+		frames.erase(frames.begin());
+
+	std::vector<snapshot> snaps(frames.size());
+	double start=now_msec();
+	for (size_t i=0;i<frames.size();i++){
+		run_frames(g,render,mov,i?frames[i-1]:0,frames[i]);
+		take_snapshot(g,render,frames[i],snaps[i]);
+	}
+	double msec=now_msec()-start;
+
+	if (!save_snapshots(path,snaps)){
+		fprintf(stderr,"cannot write %s\n",path);
+		return 2;
+	}
+	printf("recorded %d snapshots over %d frames in %.1f s (%.0f fps)\n",
+		(int)snaps.size(),length,msec/1000,length*1000/(msec>0?msec:1));
+	return 0;
+}
+
+static int verify(gb *master,movie *mov,const char *path,int threads)
+{
+	std::vector<snapshot> snaps;
+	if (!load_snapshots(path,snaps)){
+		fprintf(stderr,"cannot read %s\n",path);
+		return 2;
+	}
+	if (snaps.back().frame>mov->get_length()){
+		fprintf(stderr,"%s is longer than the movie\n",path);
+		return 2;
+	}
+
+	int segments=(int)snaps.size()-1;
+	if (threads>segments)
+		threads=segments;
+	if (threads<1)
+		threads=1;
+
+	// 各スレッドの gb は ROM を共有して作る (fork)
+	std::vector<dmy_renderer*> renders(threads);
+	std::vector<gb*> gbs(threads);
+	for (int i=0;i<threads;i++){
+		renders[i]=new dmy_renderer();
+		renders[i]->set_fixed_time(mov->get_rtc_base());
+		gbs[i]=master->fork(renders[i]);
+		gbs[i]->get_apu()->set_sound_enable(false);
+	}
+
+	std::vector<segment_result> results(segments>0?segments:0);
+	std::atomic<int> next(0);
+	double start=now_msec();
+
+	auto worker=[&](int id){
+		gb *g=gbs[id];
+		dmy_renderer *render=renders[id];
+		qword hash[HASH_COUNT];
+		int seg;
+		while ((seg=next++)<segments){
+			snapshot &from=snaps[seg],&to=snaps[seg+1];
+			segment_result &res=results[seg];
+			double t=now_msec();
+
+			if (g->restore_state_mem(&from.state[0],(int)from.state.size())){
+				render->set_timer_state(from.timer);
+				hash_log::calc(g,hash);
+				res.part=diff_part(hash,from.hash);
+			}
+			else
+				res.part=HASH_COUNT;
+			res.b_start=res.part>=0;
+			if (!res.b_start){
+				run_frames(g,render,mov,from.frame,to.frame);
+				hash_log::calc(g,hash);
+				res.part=diff_part(hash,to.hash);
+			}
+			res.msec=now_msec()-t;
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int i=1;i<threads;i++)
+		pool.push_back(std::thread(worker,i));
+	worker(0);
+	for (size_t i=0;i<pool.size();i++)
+		pool[i].join();
+	double msec=now_msec()-start;
+
+	int failed=0;
+	double total=0;
+	for (int i=0;i<segments;i++){
+		total+=results[i].msec;
+		if (results[i].part<0)
+			continue;
+		failed++;
+		if (results[i].part==HASH_COUNT)
+			printf("FAIL frame %d: cannot restore the snapshot\n",snaps[i].frame);
+		else if (results[i].b_start)
+			printf("FAIL frame %d: %s differs right after restoring the snapshot\n",snaps[i].frame,part_name[results[i].part]);
+		else
+			printf("FAIL frames %d-%d: %s differs\n",snaps[i].frame,snaps[i+1].frame,part_name[results[i].part]);
+	}
+	int length=snaps.back().frame-snaps.front().frame;
+	printf("%d/%d segments ok, %d frames on %d threads in %.1f s (%.0f fps, %.1fx)\n",
+		segments-failed,segments,length,threads,msec/1000,length*1000/(msec>0?msec:1),total/(msec>0?msec:1));
+
+	for (int i=0;i<threads;i++){
+		delete gbs[i];
+		delete renders[i];
+	}
+	return failed?1:0;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: tgb_regress record <rom> <movie> <snapshots> [-e every] [-f frame,frame,...]\n"
+		"       tgb_regress verify <rom> <movie> <snapshots> [-j threads]\n");
+}
+
+int main(int argc,char **argv)
+{
+	if (argc<5||(strcmp(argv[1],"record")&&strcmp(argv[1],"verify"))){
+		usage();
+		return 2;
+	}
+	bool b_record=!strcmp(argv[1],"record");
+
+	int every=0,threads=(int)std::thread::hardware_concurrency();
+	std::vector<int> frames;
+	for (int i=5;i<argc;i++){
+		if (!strcmp(argv[i],"-e")&&i+1<argc)
+			every=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"-f")&&i+1<argc)
+			parse_frames(argv[++i],frames);
+		else if (!strcmp(argv[i],"-j")&&i+1<argc)
+			threads=atoi(argv[++i]);
+		else{
+			usage();
+			return 2;
+		}
+	}
+
+	std::vector<byte> rom_dat;
+	if (!read_file(argv[2],rom_dat)||rom_dat.empty()){
+		fprintf(stderr,"cannot read %s\n",argv[2]);
+		return 2;
+	}
+
+	movie mov;
+	FILE *file=fopen(argv[3],"rb");
+	bool b_movie=file&&mov.load(file);
+	if (file)
+		fclose(file);
+	if (!b_movie){
+		fprintf(stderr,"cannot read %s\n",argv[3]);
+		return 2;
+	}
+
+	dmy_renderer render;
+	gb g(&render,true,true);
+	if (!g.load_rom(&rom_dat[0],(int)rom_dat.size(),NULL,0)){
+		fprintf(stderr,"cannot load %s\n",argv[2]);
+		return 2;
+	}
+	g.get_apu()->set_sound_enable(false);
+	render.set_fixed_time(mov.get_rtc_base());
+	render.set_timer_state(mov.get_rtc_offset());
+	if (!mov.start_play(&g)){
+		fprintf(stderr,"%s was not recorded with this ROM\n",argv[3]);
+		return 2;
+	}
+
+	if (!b_record)
+		return verify(&g,&mov,argv[4],threads);
+
+	for (int frame=every;every>0&&frame<mov.get_length();frame+=every)
+		frames.push_back(frame);
+	return record(&g,&render,&mov,argv[4],frames);
+}
@@ -0,0 +1,77 @@
+﻿/*--------------------------------------------------
+   TGB Dual - Gameboy Emulator -
+   Copyright (C) 2001  Hii
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License
+   as published by the Free Software Foundation; either version 2
+   of the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+//--------------------------------------------------
+// 命令トレース (saveTrace の出力) をテキストにする
+//
+// tgb_trace <trace.bin> [-n last] [-p adr]
+// -n : 最後の last 命令だけ
+// -p : PC が adr (16 進) の命令だけ
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../gb_core/trace.h"
+
+static void usage()
+{
+	fprintf(stderr,"usage: tgb_trace <trace.bin> [-n last] [-p adr]\n");
+}
+
+int main(int argc,char **argv)
+{
+	if (argc<2){
+		usage();
+		return 2;
+	}
+
+	int last=0,pc=-1;
+	for (int i=2;i<argc;i++){
+		if (!strcmp(argv[i],"-n")&&i+1<argc)
+			last=atoi(argv[++i]);
+		else if (!strcmp(argv[i],"-p")&&i+1<argc)
+			pc=(int)strtol(argv[++i],NULL,16)&0xffff;
+		else{
+			usage();
+			return 2;
+		}
+	}
+
+	FILE *file=fopen(argv[1],"rb");
+	std::vector<trace_record> recs;
+	bool ret=file&&trace_ring::load(file,recs);
+	if (file)
+		fclose(file);
+	if (!ret){
+		fprintf(stderr,"cannot read %s\n",argv[1]);
+		return 2;
+	}
+
+	char line[256];
+	size_t top=(last>0&&(size_t)last<recs.size())?recs.size()-last:0;
+	for (size_t i=top;i<recs.size();i++){
+		if (pc>=0&&recs[i].pc!=pc)
+			continue;
+		trace_ring::format(line,recs[i]);
+		puts(line);
+	}
+	return 0;
+}
@@ -25,6 +25,7 @@ dmy_renderer::dmy_renderer()
 {
 	key_state=0;
 	cur_time=0;
+	fixed_time=0;
 }
 
 dmy_renderer::~dmy_renderer()
@@ -39,6 +39,9 @@ public:
 	virtual int check_pad();
 	void set_pad(int state);
 	void set_fixed_time(dword time);
+	dword get_fixed_time() { return fixed_time; }
+	int get_timer_state() { return cur_time; }
+	void set_timer_state(int timer) { cur_time=timer; }
 
 private:
 	int key_state;
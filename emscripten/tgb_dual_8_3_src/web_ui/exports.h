@@ -7,16 +7,154 @@
 	extern "C" {
 #endif
 
+struct tgb_instance;
+struct gb_counters; // gb_core/counters.h
+struct break_hit; // gb_core/debugger.h
+
+// runFrames の flags
+#define RUN_RENDER_LAST 1 // 最後のフレームだけ画面を作る
+#define RUN_AUDIO 2 // 音を getRenderedAudio に溜める (リングバッファには積まない)
+#define RUN_NO_SOUND 4 // 音を作らない (RUN_AUDIO より優先)
+
+// runFrames の結果
+struct tgb_run_status {
+	int frames; // 進めたフレーム数 (ムービーが終わると n より少ない)
+	int samples; // 作った音のサンプル数 (L/R で 1 つ)
+	int vblanks; // VBlank に入った回数 (LCD が止まっている間は増えない)
+	int hit; // ブレークポイントに当たってそのフレームで止めた時 1
+};
+
+// エミュレータごとのハンドル (1 プロセスで複数台動かす用)
+EMSCRIPTEN_KEEPALIVE struct tgb_instance* tgbCreate();
+EMSCRIPTEN_KEEPALIVE void tgbDestroy(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE void tgbLoadRom(struct tgb_instance *inst, int size, unsigned char* dat, int sramSize, unsigned char* sram);
+EMSCRIPTEN_KEEPALIVE void tgbReset(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE void tgbSetKeys(struct tgb_instance *inst, int keys);
+EMSCRIPTEN_KEEPALIVE void tgbRunFrame(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE struct tgb_run_status* tgbRunFrames(struct tgb_instance *inst, int n, int flags);
+EMSCRIPTEN_KEEPALIVE bool tgbLink(struct tgb_instance *a, struct tgb_instance *b);
+EMSCRIPTEN_KEEPALIVE void tgbUnlink(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE unsigned char* tgbGetFrame(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE short* tgbGetAudio(struct tgb_instance *inst, int size);
+EMSCRIPTEN_KEEPALIVE byte* tgbGetSram(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbGetStateSize(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbSaveStateMem(struct tgb_instance *inst, byte *buf, int size);
+EMSCRIPTEN_KEEPALIVE bool tgbRestoreStateMem(struct tgb_instance *inst, byte *buf, int size);
+EMSCRIPTEN_KEEPALIVE struct gb_counters* tgbGetCounters(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE void tgbClearCounters(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE bool tgbSetProfile(struct tgb_instance *inst, int interval);
+EMSCRIPTEN_KEEPALIVE void tgbClearProfile(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE bool tgbLoadProfileSym(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE bool tgbSaveProfileReport(struct tgb_instance *inst, char *path, int maxLines);
+EMSCRIPTEN_KEEPALIVE void tgbSetTrace(struct tgb_instance *inst, bool enable);
+EMSCRIPTEN_KEEPALIVE void tgbSetTraceSize(struct tgb_instance *inst, int records);
+EMSCRIPTEN_KEEPALIVE void tgbClearTrace(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE bool tgbSaveTrace(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE int tgbAddBreakpoint(struct tgb_instance *inst, int pc, int bank);
+EMSCRIPTEN_KEEPALIVE int tgbAddWatchpoint(struct tgb_instance *inst, int start, int end, int type);
+EMSCRIPTEN_KEEPALIVE bool tgbRemoveBreak(struct tgb_instance *inst, int id);
+EMSCRIPTEN_KEEPALIVE void tgbClearBreaks(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE struct break_hit* tgbGetBreakHit(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE void tgbResumeBreak(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE void tgbSaveState(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE void tgbRestoreState(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE void tgbSetRewind(struct tgb_instance *inst, int interval, int capacity);
+EMSCRIPTEN_KEEPALIVE bool tgbRewindFrame(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbGetRewindCount(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE void tgbSetSkip(struct tgb_instance *inst, int frame);
+EMSCRIPTEN_KEEPALIVE void tgbSaveSram(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE void tgbSetSaveCompression(struct tgb_instance *inst, bool enable);
+EMSCRIPTEN_KEEPALIVE void tgbSaveStateAsync(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE void tgbSaveSramAsync(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE void tgbSetAutoSave(struct tgb_instance *inst, char *path, int frames);
+EMSCRIPTEN_KEEPALIVE void tgbSetRunAhead(struct tgb_instance *inst, int frames);
+EMSCRIPTEN_KEEPALIVE void tgbSetRtcBase(struct tgb_instance *inst, int seconds);
+EMSCRIPTEN_KEEPALIVE void tgbStartMovieRecord(struct tgb_instance *inst, bool fromState);
+EMSCRIPTEN_KEEPALIVE bool tgbSaveMovie(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE bool tgbPlayMovie(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE void tgbStopMovie(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbGetMovieMode(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbGetMovieFrame(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbGetMovieLength(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbPlayMovieFast(struct tgb_instance *inst, int frames);
+EMSCRIPTEN_KEEPALIVE bool tgbStartHashLog(struct tgb_instance *inst, char *path);
+EMSCRIPTEN_KEEPALIVE void tgbStopHashLog(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbCompareHashLogs(struct tgb_instance *inst, char *pathA, char *pathB);
+EMSCRIPTEN_KEEPALIVE int tgbGetHashLogDiffPart(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE unsigned int tgbGetFrameHash(struct tgb_instance *inst, int part);
+EMSCRIPTEN_KEEPALIVE char* tgbGetCartName(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbGetCartType(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE byte tgbGetRomSize(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE byte tgbGetRamSize(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE bool tgbGetCheckSum(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE int tgbGetGBType(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE float* tgbGetAudioF(struct tgb_instance *inst, int size);
+EMSCRIPTEN_KEEPALIVE int tgbGetSoundFill(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE void tgbEnableSoundStems(struct tgb_instance *inst, bool enable);
+EMSCRIPTEN_KEEPALIVE short* tgbGetSoundStems(struct tgb_instance *inst, int size);
+EMSCRIPTEN_KEEPALIVE int tgbRenderAudio(struct tgb_instance *inst, int frames);
+EMSCRIPTEN_KEEPALIVE short* tgbGetRenderedAudio(struct tgb_instance *inst);
+EMSCRIPTEN_KEEPALIVE void tgbEnableSound(struct tgb_instance *inst, bool enable);
+EMSCRIPTEN_KEEPALIVE void tgbEnableSoundChannel(struct tgb_instance *inst, int ch, bool enable);
+EMSCRIPTEN_KEEPALIVE void tgbEnableSoundEcho(struct tgb_instance *inst, bool enable);
+EMSCRIPTEN_KEEPALIVE void tgbEnableSoundLowPass(struct tgb_instance *inst, bool enable);
+EMSCRIPTEN_KEEPALIVE void tgbEnableScreenLayer(struct tgb_instance *inst, int layer, bool enable);
+EMSCRIPTEN_KEEPALIVE void tgbSetGBType(struct tgb_instance *inst, int type);
+
 EMSCRIPTEN_KEEPALIVE void loadRom(int size, unsigned char* dat, int sramSize, unsigned char* sram);
 EMSCRIPTEN_KEEPALIVE void nextFrame();
+EMSCRIPTEN_KEEPALIVE struct tgb_run_status* runFrames(int n, int flags);
+EMSCRIPTEN_KEEPALIVE struct gb_counters* getCounters();
+EMSCRIPTEN_KEEPALIVE void clearCounters();
+EMSCRIPTEN_KEEPALIVE bool setProfile(int interval);
+EMSCRIPTEN_KEEPALIVE void clearProfile();
+EMSCRIPTEN_KEEPALIVE bool loadProfileSym(char *path);
+EMSCRIPTEN_KEEPALIVE bool saveProfileReport(char *path, int maxLines);
+EMSCRIPTEN_KEEPALIVE void setTrace(bool enable);
+EMSCRIPTEN_KEEPALIVE void setTraceSize(int records);
+EMSCRIPTEN_KEEPALIVE void clearTrace();
+EMSCRIPTEN_KEEPALIVE bool saveTrace(char *path);
+EMSCRIPTEN_KEEPALIVE int addBreakpoint(int pc, int bank);
+EMSCRIPTEN_KEEPALIVE int addWatchpoint(int start, int end, int type);
+EMSCRIPTEN_KEEPALIVE bool removeBreak(int id);
+EMSCRIPTEN_KEEPALIVE void clearBreaks();
+EMSCRIPTEN_KEEPALIVE struct break_hit* getBreakHit();
+EMSCRIPTEN_KEEPALIVE void resumeBreak();
+EMSCRIPTEN_KEEPALIVE void setRunAhead(int frames);
+EMSCRIPTEN_KEEPALIVE void setRtcBase(int seconds);
+EMSCRIPTEN_KEEPALIVE void startMovieRecord(bool fromState);
+EMSCRIPTEN_KEEPALIVE bool saveMovie(char *path);
+EMSCRIPTEN_KEEPALIVE bool playMovie(char *path);
+EMSCRIPTEN_KEEPALIVE void stopMovie();
+EMSCRIPTEN_KEEPALIVE int getMovieMode();
+EMSCRIPTEN_KEEPALIVE int getMovieFrame();
+EMSCRIPTEN_KEEPALIVE int getMovieLength();
+EMSCRIPTEN_KEEPALIVE int playMovieFast(int frames);
+EMSCRIPTEN_KEEPALIVE bool startHashLog(char *path);
+EMSCRIPTEN_KEEPALIVE void stopHashLog();
+EMSCRIPTEN_KEEPALIVE int compareHashLogs(char *pathA, char *pathB);
+EMSCRIPTEN_KEEPALIVE int getHashLogDiffPart();
+EMSCRIPTEN_KEEPALIVE unsigned int getFrameHash(int part);
 EMSCRIPTEN_KEEPALIVE void initTgbDual();
 EMSCRIPTEN_KEEPALIVE void freeTgbDual();
 EMSCRIPTEN_KEEPALIVE void reset();
 EMSCRIPTEN_KEEPALIVE void saveState(char *path);
 EMSCRIPTEN_KEEPALIVE void restoreState(char *path);
+EMSCRIPTEN_KEEPALIVE int getStateSize();
+EMSCRIPTEN_KEEPALIVE int saveStateMem(byte *buf, int size);
+EMSCRIPTEN_KEEPALIVE bool restoreStateMem(byte *buf, int size);
+EMSCRIPTEN_KEEPALIVE void setRewind(int interval, int capacity);
+EMSCRIPTEN_KEEPALIVE bool rewindFrame();
+EMSCRIPTEN_KEEPALIVE int getRewindCount();
 EMSCRIPTEN_KEEPALIVE void setSkip(int frame);
 EMSCRIPTEN_KEEPALIVE byte* getSram();
 EMSCRIPTEN_KEEPALIVE void saveSram(char *path);
+EMSCRIPTEN_KEEPALIVE void saveStateAsync(char *path);
+EMSCRIPTEN_KEEPALIVE void saveSramAsync(char *path);
+EMSCRIPTEN_KEEPALIVE void flushSaves();
+EMSCRIPTEN_KEEPALIVE int getPendingSaves();
+EMSCRIPTEN_KEEPALIVE void setAutoSave(char *path, int frames);
+EMSCRIPTEN_KEEPALIVE void setSaveCompression(bool enable);
 
 EMSCRIPTEN_KEEPALIVE char* getCartName();
 EMSCRIPTEN_KEEPALIVE int getCartType();
@@ -28,8 +166,15 @@ EMSCRIPTEN_KEEPALIVE int getGBType();
 EMSCRIPTEN_KEEPALIVE unsigned char* getBytes();
 EMSCRIPTEN_KEEPALIVE short* getSoundBytes(int size);
 EMSCRIPTEN_KEEPALIVE float* getSoundBytesF(int size);
+EMSCRIPTEN_KEEPALIVE int getSoundFill();
+EMSCRIPTEN_KEEPALIVE void enableSoundStems(bool enable);
+EMSCRIPTEN_KEEPALIVE short* getSoundStems(int size);
 EMSCRIPTEN_KEEPALIVE void setKeys(int down, int up, int left, int right, int a, int b, int select, int start);
 
+EMSCRIPTEN_KEEPALIVE int renderAudio(int frames);
+EMSCRIPTEN_KEEPALIVE short* getRenderedAudio();
+
+EMSCRIPTEN_KEEPALIVE void enableSound(bool enable);
 EMSCRIPTEN_KEEPALIVE void enableSoundChannel(int ch, bool enable);
 EMSCRIPTEN_KEEPALIVE void enableSoundEcho(bool enable);
 EMSCRIPTEN_KEEPALIVE void enableSoundLowPass(bool enable);
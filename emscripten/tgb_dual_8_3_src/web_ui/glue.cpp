@@ -1,5 +1,15 @@
 ﻿#include <list>
+#include <vector>
+#include <string>
 #include "../gb_core/gb.h"
+#include "../gb_core/state_writer.h"
+#include "../gb_core/lz.h"
+#include "../gb_core/movie.h"
+#include "../gb_core/hash_log.h"
+#include "../gb_core/link_cable.h"
+#include "../gb_core/profiler.h"
+#include "../gb_core/trace.h"
+#include "../gb_core/debugger.h"
 #include "../gbr_interface/gbr.h"
 #include "dmy_renderer.h"
 #include "web_renderer.h"
@@ -40,16 +50,12 @@ static const char mbc_types[0x101][40]={"ROM Only","ROM + MBC1","ROM + MBC1 + RA
 									"","","","","","","","","","","","","","Bandai TAMA5","Hudson HuC-3","Hudson HuC-1",//#FF
 									"mmm01" // 逃げ
 };
-static byte org_gbtype[2];
-
 //#define hide
 
 static bool sram_transfer_rest=false;
 static bool b_running=true;
 
-gb *g_gb[2];
 gbr *g_gbr;
-web_renderer *render[2];
 //dx_renderer *render[2];
 //#ifndef hide
 //dx_renderer *dmy_render;
@@ -58,6 +64,7 @@ web_renderer *render[2];
 //#endif
 //setting *config;
 std::list<char*> mes_list,chat_list;
+static state_writer *writer=NULL; // 予約済みの書き込みがあるので破棄しない (全インスタンスで共有)
 
 struct netplay_data{
 	int key;
@@ -67,7 +74,6 @@ struct netplay_data{
 //tgb_netplay *net=NULL;
 int sended=0;
 
-int cur_mode;
 enum mode{
 	UNLOADED,
 	NORMAL_MODE,
@@ -78,35 +84,113 @@ enum mode{
 
 FILE* log_file;
 
+// エミュレータ 1 台分の状態 (tgbCreate で作り、ハンドルとして JS に渡す)
+// 従来の API (initTgbDual/nextFrame 等) は g_inst を使う
+struct tgb_instance{
+	gb *g;
+	web_renderer *render;
+	int cur_mode;
+	int gb_type; // Auto:0, GB:1, GBC:3, GBA:4
+	byte org_gbtype;
+
+	std::vector<short> offline_sound;
+	int run_ahead_frames;
+	std::vector<byte> run_ahead_state;
+	std::string auto_save_path;
+	int auto_save_interval,auto_save_count;
+	movie mov;
+	hash_log log;
+
+	link_cable *link; // tgbLink でつないだ相手と共有
+	tgb_instance *link_peer;
+	bool link_primary; // こちらの tgbRunFrame で 2 台とも進める
+
+	tgb_run_status run_status; // tgbRunFrames の結果
+	bool b_compress; // ステート/SRAM を lz_pack して書き出す
+	int hash_diff_part; // tgbCompareHashLogs で最初に違った場所
+};
+
+static tgb_instance *g_inst=NULL;
 
 //	int cart_type;
 //	byte rom_size;
 //	byte ram_size;
 //	bool check_sum;
-int gb_type = 0;
+
+char* tgbGetCartName(tgb_instance *inst) {
+	return inst->g->get_rom()->get_info()->cart_name;
+}
 
 char* getCartName() {
-	return g_gb[0]->get_rom()->get_info()->cart_name;
+	return tgbGetCartName(g_inst);
+}
+
+int tgbGetCartType(tgb_instance *inst) {
+	return inst->g->get_rom()->get_info()->cart_type;
 }
 
 int getCartType() {
-	return g_gb[0]->get_rom()->get_info()->cart_type;
+	return tgbGetCartType(g_inst);
+}
+
+byte tgbGetRomSize(tgb_instance *inst) {
+	return inst->g->get_rom()->get_info()->rom_size;
 }
 
 byte getRomSize() {
-	return g_gb[0]->get_rom()->get_info()->rom_size;
+	return tgbGetRomSize(g_inst);
+}
+
+byte tgbGetRamSize(tgb_instance *inst) {
+	return inst->g->get_rom()->get_info()->ram_size;
 }
 
 byte getRamSize() {
-	return g_gb[0]->get_rom()->get_info()->ram_size;
+	return tgbGetRamSize(g_inst);
+}
+
+bool tgbGetCheckSum(tgb_instance *inst) {
+	return inst->g->get_rom()->get_info()->check_sum;
 }
 
 bool getCheckSum() {
-	return g_gb[0]->get_rom()->get_info()->check_sum;
+	return tgbGetCheckSum(g_inst);
+}
+
+int tgbGetGBType(tgb_instance *inst) {
+	return inst->g->get_rom()->get_info()->gb_type;
 }
 
 int getGBType() {
-	return g_gb[0]->get_rom()->get_info()->gb_type;
+	return tgbGetGBType(g_inst);
+}
+
+tgb_instance *tgbCreate() {
+	tgb_instance *inst = new tgb_instance();
+	inst->g = NULL;
+	inst->render = new web_renderer();
+	inst->cur_mode = UNLOADED;
+	inst->gb_type = 0;
+	inst->org_gbtype = 0;
+	inst->run_ahead_frames = 0;
+	inst->auto_save_interval = inst->auto_save_count = 0;
+	inst->link = NULL;
+	inst->link_peer = NULL;
+	inst->link_primary = false;
+	inst->b_compress = false;
+	inst->hash_diff_part = -1;
+	return inst;
+}
+
+void tgbDestroy(tgb_instance *inst) {
+	if (!inst) {
+		return;
+	}
+	tgbUnlink(inst);
+	inst->log.close();
+	delete inst->g;
+	delete inst->render;
+	delete inst;
 }
 
 void initTgbDual()
@@ -116,7 +200,7 @@ void initTgbDual()
 	//	Module.print("I received: ");
 	//);
 
-	render[0] = new web_renderer();
+	g_inst = tgbCreate();
 	
 	/*
 	render[0]=new dx_renderer(hWnd,hInst);
@@ -129,81 +213,249 @@ void initTgbDual()
 	render[0]->show_fps(config->show_fps);
 
 	*/
-	cur_mode=UNLOADED;
 }
 
 void freeTgbDual() {
-	if (g_gb[0]){
-		delete g_gb[0];
-		g_gb[0] = 0;
-	}
-	if (render[0]) {
-		delete render[0];
-		render[0] = 0;
-	}
+	flushSaves();
+	tgbDestroy(g_inst);
+	g_inst = NULL;
 }
 
 void reset() {
-	g_gb[0]->reset();
+	tgbReset(g_inst);
 	//g_gb[0]->get_renderer()->reset();
 }
 
+void tgbSaveState(tgb_instance *inst, char *path) {
+	FILE *file = fopen(path, "wb");
+	if (inst->b_compress) {
+		std::vector<byte> raw(inst->g->get_state_size()), packed;
+		inst->g->save_state_mem(&raw[0], raw.size());
+		lz_pack(&raw[0], raw.size(), packed);
+		fwrite(&packed[0], 1, packed.size(), file);
+	} else {
+		inst->g->save_state(file);
+	}
+	fclose(file);
+}
+
 void saveState(char *path) {
-	FILE *file = fopen(path, "w");
-	g_gb[0]->save_state(file);
+	tgbSaveState(g_inst, path);
+}
+
+void tgbRestoreState(tgb_instance *inst, char *path) {
+	FILE *file = fopen(path, "rb");
+	inst->g->restore_state(file);
 	fclose(file);
 }
 
 void restoreState(char *path) {
-	FILE *file = fopen(path, "r");
-	g_gb[0]->restore_state(file);
-	fclose(file);
+	tgbRestoreState(g_inst, path);
+}
+
+int tgbGetStateSize(tgb_instance *inst) {
+	int size = inst->g->get_state_size();
+	return inst->b_compress ? 8 + lz_bound(size) : size;
+}
+
+int getStateSize() {
+	return tgbGetStateSize(g_inst);
+}
+
+// buf は tgbGetStateSize() バイト以上確保しておくこと
+int tgbSaveStateMem(tgb_instance *inst, byte *buf, int size) {
+	if (!inst->b_compress) {
+		return inst->g->save_state_mem(buf, size);
+	}
+	std::vector<byte> raw(inst->g->get_state_size()), packed;
+	inst->g->save_state_mem(&raw[0], raw.size());
+	lz_pack(&raw[0], raw.size(), packed);
+	if ((int)packed.size() > size) {
+		return 0;
+	}
+	memcpy(buf, &packed[0], packed.size());
+	return packed.size();
+}
+
+int saveStateMem(byte *buf, int size) {
+	return tgbSaveStateMem(g_inst, buf, size);
+}
+
+bool tgbRestoreStateMem(tgb_instance *inst, byte *buf, int size) {
+	return inst->g->restore_state_mem(buf, size);
+}
+
+bool restoreStateMem(byte *buf, int size) {
+	return tgbRestoreStateMem(g_inst, buf, size);
+}
+
+// interval フレームごとに巻き戻し用の履歴を取る (0 で無効)
+void tgbSetRewind(tgb_instance *inst, int interval, int capacity) {
+	if (inst->g) {
+		inst->g->set_rewind(interval, capacity);
+	}
+}
+
+void setRewind(int interval, int capacity) {
+	tgbSetRewind(g_inst, interval, capacity);
+}
+
+bool tgbRewindFrame(tgb_instance *inst) {
+	if (!inst->g || !inst->g->get_rewinder()) {
+		return false;
+	}
+	return inst->g->get_rewinder()->rewind();
+}
+
+bool rewindFrame() {
+	return tgbRewindFrame(g_inst);
+}
+
+int tgbGetRewindCount(tgb_instance *inst) {
+	if (!inst->g || !inst->g->get_rewinder()) {
+		return 0;
+	}
+	return inst->g->get_rewinder()->get_count();
+}
+
+int getRewindCount() {
+	return tgbGetRewindCount(g_inst);
+}
+
+void tgbSetSkip(tgb_instance *inst, int frame) {
+	if (inst->g) {
+		inst->g->set_skip(frame);
+	}
 }
 
 void setSkip(int frame) {
-	g_gb[0]->set_skip(frame);
+	tgbSetSkip(g_inst, frame);
 }
 
 byte* getSram() {
-	return g_gb[0]->get_rom()->get_sram();
+	return tgbGetSram(g_inst);
 }
 
-void saveSram(char *path) {
-	BYTE *buf = g_gb[0]->get_rom()->get_sram();
-	int size = g_gb[0]->get_rom()->get_info()->ram_size;
-	int num = 0;
+// .sav の中身 (SRAM と MBC3 のタイマー)
+static void get_sram_image(tgb_instance *inst, std::vector<byte> &out) {
+	BYTE *buf = inst->g->get_rom()->get_sram();
+	int size = inst->g->get_rom()->get_info()->ram_size;
+
+	int sram_tbl[]={1,1,1,4,16,8};
+	out.assign(buf, buf + 0x2000*sram_tbl[size]);
+	if ((inst->g->get_rom()->get_info()->cart_type>=0x0f)&&(inst->g->get_rom()->get_info()->cart_type<=0x13)){
+		int tmp=inst->render->get_timer_state();
+		out.insert(out.end(), (byte*)&tmp, (byte*)&tmp + 4);
+	}
+}
+
+void tgbSaveSram(tgb_instance *inst, char *path) {
 	//if (strstr(tmp_sram_name[num],".srt"))
 	//	return;
 
-	int sram_tbl[]={1,1,1,4,16,8};
 	//char cur_di[256],sv_dir[256];
 	//GetCurrentDirectory(256,cur_di);
 	//config->get_save_dir(sv_dir);
 	//SetCurrentDirectory(sv_dir);
-	FILE *fs=fopen(path,"wb");
-	fwrite(buf,1,0x2000*sram_tbl[size],fs);
-	if ((g_gb[num]->get_rom()->get_info()->cart_type>=0x0f)&&(g_gb[num]->get_rom()->get_info()->cart_type<=0x13)){
-		int tmp=render[0]->get_timer_state();
-		fwrite(&tmp,4,1,fs);
+	std::vector<byte> dat;
+	get_sram_image(inst, dat);
+	if (inst->b_compress) {
+		std::vector<byte> packed;
+		lz_pack(&dat[0], dat.size(), packed);
+		dat.swap(packed);
 	}
+	FILE *fs=fopen(path,"wb");
+	fwrite(&dat[0],1,dat.size(),fs);
 	fclose(fs);
 	//SetCurrentDirectory(cur_di);
 }
 
-void loadRom(int size, unsigned char* dat, int sramSize, unsigned char* sram)
+void saveSram(char *path) {
+	tgbSaveSram(g_inst, path);
+}
+
+static state_writer *get_writer() {
+	if (!writer) {
+		writer = new state_writer();
+	}
+	return writer;
+}
+
+// 以降に書き出すステート/SRAM を圧縮するか (読み込みはどちらでも可)
+void tgbSetSaveCompression(tgb_instance *inst, bool enable) {
+	inst->b_compress = enable;
+}
+
+void setSaveCompression(bool enable) {
+	tgbSetSaveCompression(g_inst, enable);
+}
+
+// メモリに取るところまでをここで行い、ファイルへの書き込みは後で (別スレッド等) 行う
+void tgbSaveStateAsync(tgb_instance *inst, char *path) {
+	get_writer()->save_state(inst->g, path, inst->b_compress);
+}
+
+void saveStateAsync(char *path) {
+	tgbSaveStateAsync(g_inst, path);
+}
+
+void tgbSaveSramAsync(tgb_instance *inst, char *path) {
+	std::vector<byte> dat;
+	get_sram_image(inst, dat);
+	get_writer()->write(path, &dat[0], dat.size(), inst->b_compress);
+}
+
+void saveSramAsync(char *path) {
+	tgbSaveSramAsync(g_inst, path);
+}
+
+// 書き込み待ちが無くなるまで待つ (全インスタンスの分)
+void flushSaves() {
+	if (writer) {
+		writer->flush();
+	}
+}
+
+int getPendingSaves() {
+	return writer ? writer->get_pending() : 0;
+}
+
+// frames フレームごとに path へステートを書き出す (0 で無効)
+void tgbSetAutoSave(tgb_instance *inst, char *path, int frames) {
+	inst->auto_save_path = path ? path : "";
+	inst->auto_save_interval = (frames > 0 && path) ? frames : 0;
+	inst->auto_save_count = 0;
+}
+
+void setAutoSave(char *path, int frames) {
+	tgbSetAutoSave(g_inst, path, frames);
+}
+
+static void auto_save(tgb_instance *inst) {
+	if (inst->auto_save_interval <= 0 || ++inst->auto_save_count < inst->auto_save_interval) {
+		return;
+	}
+	inst->auto_save_count = 0;
+	get_writer()->save_state(inst->g, inst->auto_save_path.c_str(), inst->b_compress);
+}
+
+// 本来のフレームを進め終わった時の処理 (巻き戻し/自動保存/ハッシュの記録)
+static void frame_end(tgb_instance *inst) {
+	if (inst->g->get_rewinder())
+		inst->g->get_rewinder()->frame();
+	auto_save(inst);
+	inst->log.frame(inst->g);
+}
+
+void tgbLoadRom(tgb_instance *inst, int size, unsigned char* dat, int sramSize, unsigned char* sram)
 {
 	int num = 0;
 	//int size;
 	//BYTE *dat;
 	
-	if (!g_gb[num]){
-		g_gb[num]=new gb(render[num],true,(num)?false:true);
-		g_gb[num]->set_target(NULL);
-
-		if (g_gb[num?0:1]){
-			g_gb[0]->set_target(g_gb[1]);
-			g_gb[1]->set_target(g_gb[0]);
-		}
+	if (!inst->g){
+		inst->g=new gb(inst->render,true,(num)?false:true);
+		inst->g->set_target(NULL);
 
 		//if (config->sound_enable[4]){
 		if (false){
@@ -213,10 +465,10 @@ void loadRom(int size, unsigned char* dat, int sramSize, unsigned char* sram)
 			//g_gb[num]->get_apu()->get_renderer()->set_enable(3,config->sound_enable[3]?true:false);
 		}
 		else{
-			g_gb[num]->get_apu()->get_renderer()->set_enable(0,true);
-			g_gb[num]->get_apu()->get_renderer()->set_enable(1,true);
-			g_gb[num]->get_apu()->get_renderer()->set_enable(2,true);
-			g_gb[num]->get_apu()->get_renderer()->set_enable(3,true);
+			inst->g->get_apu()->get_renderer()->set_enable(0,true);
+			inst->g->get_apu()->get_renderer()->set_enable(1,true);
+			inst->g->get_apu()->get_renderer()->set_enable(2,true);
+			inst->g->get_apu()->get_renderer()->set_enable(3,true);
 			
 			/*
 				g_gb[num]->get_lcd()->set_enable(0,true);
@@ -225,8 +477,8 @@ void loadRom(int size, unsigned char* dat, int sramSize, unsigned char* sram)
 				g_gb[num]->get_lcd()->set_enable(3,true);
 			*/
 		}
-		g_gb[num]->get_apu()->get_renderer()->set_echo(true);
-		g_gb[num]->get_apu()->get_renderer()->set_lowpass(true);
+		inst->g->get_apu()->get_renderer()->set_echo(true);
+		inst->g->get_apu()->get_renderer()->set_lowpass(true);
 	}
 	else{
 		//if (g_gb[num]->get_rom()->has_battery())
@@ -260,22 +512,27 @@ void loadRom(int size, unsigned char* dat, int sramSize, unsigned char* sram)
 	int ram_size=0x2000*tbl_ram[dat[0x149]];
 	ram=(BYTE*)malloc(ram_size);
 
-	if (sramSize <= 0) {
-		memset(ram,0,ram_size);
-	} else {
-		memcpy(ram, sram, sramSize);
+	std::vector<byte> unpacked;
+	if (sramSize > 0 && lz_unpack(sram, sramSize, unpacked)) {
+		sram = unpacked.empty() ? 0 : &unpacked[0];
+		sramSize = unpacked.size();
+	}
+	memset(ram,0,ram_size);
+	if (sramSize > 0) {
+		memcpy(ram, sram, (sramSize < ram_size) ? sramSize : ram_size);
 	}
 	
-	org_gbtype[num]=dat[0x143]&0x80;
+	inst->org_gbtype=dat[0x143]&0x80;
 	
-	if (gb_type == 1) {
+	if (inst->gb_type == 1) {
 		dat[0x143] &= 0x7f;
-	} else if (gb_type >= 3) {
+	} else if (inst->gb_type >= 3) {
 		dat[0x143] |= 0x80;
 	}
 	
 	//g_gb[num]->set_use_gba(false);
-	g_gb[num]->load_rom(dat,size,ram,ram_size);
+	inst->g->load_rom(dat,size,ram,ram_size);
+	free(ram); // rom 側で複製している
 	
 	/*
 	FILE *file;
@@ -478,7 +735,7 @@ void loadRom(int size, unsigned char* dat, int sramSize, unsigned char* sram)
 	*/
 
 	char pb[256];
-	sprintf(pb,"Load ROM slot[%d] :\ntype-%d:%s\nsize=%dKB : name=%s\n\n",num+1,g_gb[num]->get_rom()->get_info()->cart_type,mbc_types[g_gb[num]->get_rom()->get_info()->cart_type],size/1024,g_gb[num]->get_rom()->get_info()->cart_name);
+	sprintf(pb,"Load ROM slot[%d] :\ntype-%d:%s\nsize=%dKB : name=%s\n\n",num+1,inst->g->get_rom()->get_info()->cart_type,mbc_types[inst->g->get_rom()->get_info()->cart_type],size/1024,inst->g->get_rom()->get_info()->cart_name);
 	jsLog(pb);
 	
 	/*
@@ -494,8 +751,271 @@ void loadRom(int size, unsigned char* dat, int sramSize, unsigned char* sram)
 	*/
 }
 
+void loadRom(int size, unsigned char* dat, int sramSize, unsigned char* sram)
+{
+	tgbLoadRom(g_inst, size, dat, sramSize, sram);
+}
+
 
-void nextFrame()
+// 先行実行
+// 本来の1フレームを進めて状態を保存し、同じ入力のまま先のフレームまで音なしで進めて
+// その画面を出してから、保存した状態に戻す
+// 画面は通常次のフレームの先頭 (LY=0) で出るので、run_ahead_frames=1 でも
+// 本来のフレームをそのフレームのうちに出せる分だけ早くなる
+static void run_ahead(tgb_instance *inst)
+{
+	gb *g=inst->g;
+	bool sound_enable=g->get_apu()->get_sound_enable();
+	bool lcd_enable=g->get_lcd_enable();
+	int lines=154*inst->run_ahead_frames; // 本来のフレームを含めた総ライン数
+	int line;
+
+	// 本来のフレームはいつも通り描画する (vframe はステートやハッシュに入る)
+	for (line=0;line<154;line++)
+		g->run();
+	inst->render->push_sound();
+	frame_end(inst);
+
+	int size=g->get_state_size();
+	if ((int)inst->run_ahead_state.size()<size)
+		inst->run_ahead_state.resize(size);
+	g->save_state_mem(&inst->run_ahead_state[0],size);
+
+	// 先行分は最後の 2 フレーム分だけ描画する (LY=0 がフレームのどこに来るかは分からないので)
+	// 巻き戻す命令でブレークポイント等に当たったことにはしない
+	int first_render=lines-154*2+1;
+	g->suspend_tools(true);
+	g->get_apu()->set_sound_enable(false);
+	g->set_lcd_enable(lcd_enable&&line>=first_render);
+	for (;line<=lines;line++){
+		if (line==first_render)
+			g->set_lcd_enable(lcd_enable);
+		g->run();
+	}
+
+	// 音の状態 (stat_cpy 等) は保存したものに戻すので先に有効にしておく
+	g->get_apu()->set_sound_enable(sound_enable);
+	g->set_lcd_enable(lcd_enable);
+	g->suspend_tools(false);
+	g->restore_state_mem(&inst->run_ahead_state[0],size);
+}
+
+// renderAudio と runFrames (RUN_AUDIO) の音を offline_sound に集める
+// 元の set_sound_enable は呼び出し側で戻す
+static void offline_audio_begin(tgb_instance *inst, int frames) {
+	inst->offline_sound.clear();
+	inst->offline_sound.reserve(frames * 740 * 2);
+	inst->g->get_apu()->set_sound_enable(true);
+}
+
+// 1 フレーム分を後ろに足してサンプル数を返す
+static int offline_audio_frame(tgb_instance *inst) {
+	short buf[2048 * 2];
+	int samples = inst->g->get_apu()->get_renderer()->render_pending(buf, 2048);
+	inst->offline_sound.insert(inst->offline_sound.end(), buf, buf + samples * 2);
+	return samples;
+}
+
+// ムービーの記録/再生 (フレームの頭で 1 回)
+static void movie_input(tgb_instance *inst) {
+	if (inst->mov.get_mode() == MOVIE_RECORD) {
+		inst->mov.record(inst->render->check_pad());
+	} else if (inst->mov.get_mode() == MOVIE_PLAY) {
+		int pad;
+		if (inst->mov.next(&pad)) {
+			inst->render->set_pad(pad);
+		}
+	}
+}
+
+// RTC の基準時刻 (秒)。ムービーを記録する前に決めておけば再生でも同じになる
+void tgbSetRtcBase(tgb_instance *inst, int seconds) {
+	inst->render->set_fixed_time(seconds);
+	inst->render->set_timer_state(0);
+}
+
+void setRtcBase(int seconds) {
+	tgbSetRtcBase(g_inst, seconds);
+}
+
+// fromState=false の時は電源投入 (reset) から記録する
+void tgbStartMovieRecord(tgb_instance *inst, bool fromState) {
+	inst->mov.start_record(inst->g, fromState, inst->render->get_fixed_time(), inst->render->get_timer_state());
+}
+
+void startMovieRecord(bool fromState) {
+	tgbStartMovieRecord(g_inst, fromState);
+}
+
+bool tgbSaveMovie(tgb_instance *inst, char *path) {
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	bool ret = inst->mov.save(file);
+	fclose(file);
+	return ret;
+}
+
+bool saveMovie(char *path) {
+	return tgbSaveMovie(g_inst, path);
+}
+
+// 読み込んで最初から再生する。ROM が違う時は false
+bool tgbPlayMovie(tgb_instance *inst, char *path) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	bool ret = inst->mov.load(file);
+	fclose(file);
+	if (!ret) {
+		return false;
+	}
+
+	inst->render->set_fixed_time(inst->mov.get_rtc_base());
+	inst->render->set_timer_state(inst->mov.get_rtc_offset());
+	return inst->mov.start_play(inst->g);
+}
+
+bool playMovie(char *path) {
+	return tgbPlayMovie(g_inst, path);
+}
+
+void tgbStopMovie(tgb_instance *inst) {
+	inst->mov.stop();
+}
+
+void stopMovie() {
+	tgbStopMovie(g_inst);
+}
+
+int tgbGetMovieMode(tgb_instance *inst) {
+	return inst->mov.get_mode();
+}
+
+int getMovieMode() {
+	return tgbGetMovieMode(g_inst);
+}
+
+int tgbGetMovieFrame(tgb_instance *inst) {
+	return inst->mov.get_frame();
+}
+
+int getMovieFrame() {
+	return tgbGetMovieFrame(g_inst);
+}
+
+int tgbGetMovieLength(tgb_instance *inst) {
+	return inst->mov.get_length();
+}
+
+int getMovieLength() {
+	return tgbGetMovieLength(g_inst);
+}
+
+// 再生中のムービーを画面/音なしで進める (frames<=0 なら最後まで)
+// 戻り値は進めたフレーム数
+int tgbPlayMovieFast(tgb_instance *inst, int frames) {
+	if (!inst->g || inst->mov.get_mode() != MOVIE_PLAY) {
+		return 0;
+	}
+
+	gb *g = inst->g;
+	bool lcd_enable = g->get_lcd_enable();
+	bool sound_enable = g->get_apu()->get_sound_enable();
+	g->set_lcd_enable(inst->log.is_open()); // ハッシュを取る時は画面も作る
+	g->get_apu()->set_sound_enable(false);
+
+	int count = 0, pad;
+	while ((frames <= 0 || count < frames) && inst->mov.next(&pad)) {
+		inst->render->set_pad(pad);
+		for (int line = 0; line < 154; line++) {
+			g->run();
+		}
+		inst->log.frame(g);
+		count++;
+	}
+
+	g->set_lcd_enable(lcd_enable);
+	g->get_apu()->set_sound_enable(sound_enable);
+	return count;
+}
+
+int playMovieFast(int frames) {
+	return tgbPlayMovieFast(g_inst, frames);
+}
+
+// フレームごとのハッシュを path に記録する (tgbStopHashLog まで)
+bool tgbStartHashLog(tgb_instance *inst, char *path) {
+	return inst->log.open(path);
+}
+
+bool startHashLog(char *path) {
+	return tgbStartHashLog(g_inst, path);
+}
+
+void tgbStopHashLog(tgb_instance *inst) {
+	inst->log.close();
+}
+
+void stopHashLog() {
+	tgbStopHashLog(g_inst);
+}
+
+// 最初に違うフレーム (同じなら -1、比べられない時は -2)。違った場所は tgbGetHashLogDiffPart で
+int tgbCompareHashLogs(tgb_instance *inst, char *pathA, char *pathB) {
+	return hash_log::compare(pathA, pathB, &inst->hash_diff_part);
+}
+
+int compareHashLogs(char *pathA, char *pathB) {
+	return tgbCompareHashLogs(g_inst, pathA, pathB);
+}
+
+int tgbGetHashLogDiffPart(tgb_instance *inst) {
+	return inst->hash_diff_part;
+}
+
+int getHashLogDiffPart() {
+	return tgbGetHashLogDiffPart(g_inst);
+}
+
+// 今の状態のハッシュ (下位 32bit)。part は HASH_VFRAME 等
+unsigned int tgbGetFrameHash(tgb_instance *inst, int part) {
+	if (!inst->g || part < 0 || part >= HASH_COUNT) {
+		return 0;
+	}
+	qword dat[HASH_COUNT];
+	hash_log::calc(inst->g, dat);
+	return (unsigned int)dat[part];
+}
+
+unsigned int getFrameHash(int part) {
+	return tgbGetFrameHash(g_inst, part);
+}
+
+void tgbSetRunAhead(tgb_instance *inst, int frames) {
+	inst->run_ahead_frames=(frames<0)?0:frames;
+}
+
+void setRunAhead(int frames) {
+	tgbSetRunAhead(g_inst, frames);
+}
+
+// 通信ケーブルでつないだ 2 台を 1 フレーム進める (先行実行は使わない)
+static void run_linked_frame(tgb_instance *inst) {
+	tgb_instance *peer = inst->link_peer;
+
+	movie_input(inst);
+	movie_input(peer);
+	inst->link->run_frame();
+	inst->render->push_sound();
+	peer->render->push_sound();
+	frame_end(inst);
+	frame_end(peer);
+}
+
+void tgbRunFrame(tgb_instance *inst)
 {
 	//if (GetActiveWindow()) render[0]->enable_check_pad();
 	//else render[0]->disable_check_pad();
@@ -503,13 +1023,32 @@ void nextFrame()
 	//if (g_gb[0])
 	//	printf("%06x\n", g_gb[0]->get_cpu()->get_regs()->PC);
 
+	if (inst->link) {
+		// 相手側は主の方の呼び出しで一緒に進む
+		if (inst->link_primary)
+			run_linked_frame(inst);
+		return;
+	}
+
+	if (inst->g)
+		movie_input(inst);
+
+	if (inst->g&&inst->run_ahead_frames>0){
+		run_ahead(inst);
+		return;
+	}
+
 	// とりあえず実行
 	for (int line=0;line<154;line++){
-		if (g_gb[0])
-			g_gb[0]->run();
+		if (inst->g)
+			inst->g->run();
 		//if (g_gb[1])
 		//	g_gb[1]->run(); 
 	}
+	if (inst->g){
+		inst->render->push_sound();
+		frame_end(inst);
+	}
 	//if (g_gbr)
 	//	g_gbr->run();
 
@@ -530,34 +1069,476 @@ void nextFrame()
 	//if (g_gb[0]) g_gb[0]->set_skip(0);
 }
 
+void nextFrame()
+{
+	tgbRunFrame(g_inst);
+}
+
+// n フレームをまとめて進める (早送りやスクリプトからの実行用)
+// 進み方は tgbRunFrame を n 回呼ぶのと同じだが、JS との行き来は 1 回で済む (先行実行はしない)
+tgb_run_status* tgbRunFrames(tgb_instance *inst, int n, int flags) {
+	tgb_run_status *st = &inst->run_status;
+	st->frames = st->samples = st->vblanks = st->hit = 0;
+	if (!inst->g || n <= 0) {
+		return st;
+	}
+
+	if (inst->link) {
+		// つないでいる時は flags を見ずに 1 フレームずつ進める
+		if (inst->link_primary) {
+			while (st->frames < n && !st->hit) {
+				run_linked_frame(inst);
+				st->frames++;
+				st->hit = (inst->g->get_debugger()->get_hit() || inst->link_peer->g->get_debugger()->get_hit()) ? 1 : 0;
+			}
+		}
+		return st;
+	}
+
+	gb *g = inst->g;
+	gb_regs *regs = g->get_regs();
+	bool lcd_enable = g->get_lcd_enable();
+	bool sound_enable = g->get_apu()->get_sound_enable();
+	bool no_sound = (flags & RUN_NO_SOUND) != 0;
+	bool offline = !no_sound && (flags & RUN_AUDIO);
+
+	if (offline) {
+		offline_audio_begin(inst, n);
+	}
+	else if (no_sound) {
+		g->get_apu()->set_sound_enable(false);
+	}
+
+	// 画面は LY=0 に入った所で出るので、最後に出る画面はその前の 154 ライン分で描かれる
+	// LY=0 がフレームのどこに来るかは分からないので、最後の 2 フレーム分を描画する
+	int lines = n * 154;
+	int first_render = (flags & RUN_RENDER_LAST) ? lines - 154 * 2 : -1;
+	if (first_render > 0) {
+		g->set_lcd_enable(false);
+	}
+
+	int line = 0;
+	// ブレークポイントに当たったらそのフレームの終わりで止める
+	while (st->frames < n && !st->hit) {
+		movie_input(inst);
+		for (int i = 0; i < 154; i++, line++) {
+			if (line == first_render) {
+				g->set_lcd_enable(lcd_enable);
+			}
+			g->run();
+			if ((regs->LCDC & 0x80) && regs->LY == 144) {
+				st->vblanks++;
+			}
+		}
+		if (offline) {
+			st->samples += offline_audio_frame(inst);
+		}
+		else if (!no_sound) {
+			st->samples += inst->render->push_sound();
+		}
+		frame_end(inst);
+		st->frames++;
+		st->hit = g->get_debugger()->get_hit() ? 1 : 0;
+	}
+
+	g->set_lcd_enable(lcd_enable);
+	g->get_apu()->set_sound_enable(sound_enable);
+	return st;
+}
+
+tgb_run_status* runFrames(int n, int flags) {
+	return tgbRunFrames(g_inst, n, flags);
+}
+
+gb_counters* getCounters() {
+	return tgbGetCounters(g_inst);
+}
+
+void clearCounters() {
+	tgbClearCounters(g_inst);
+}
+
+bool setProfile(int interval) {
+	return tgbSetProfile(g_inst, interval);
+}
+
+void clearProfile() {
+	tgbClearProfile(g_inst);
+}
+
+bool loadProfileSym(char *path) {
+	return tgbLoadProfileSym(g_inst, path);
+}
+
+bool saveProfileReport(char *path, int maxLines) {
+	return tgbSaveProfileReport(g_inst, path, maxLines);
+}
+
+void setTrace(bool enable) {
+	tgbSetTrace(g_inst, enable);
+}
+
+void setTraceSize(int records) {
+	tgbSetTraceSize(g_inst, records);
+}
+
+void clearTrace() {
+	tgbClearTrace(g_inst);
+}
+
+bool saveTrace(char *path) {
+	return tgbSaveTrace(g_inst, path);
+}
+
+int addBreakpoint(int pc, int bank) {
+	return tgbAddBreakpoint(g_inst, pc, bank);
+}
+
+int addWatchpoint(int start, int end, int type) {
+	return tgbAddWatchpoint(g_inst, start, end, type);
+}
+
+bool removeBreak(int id) {
+	return tgbRemoveBreak(g_inst, id);
+}
+
+void clearBreaks() {
+	tgbClearBreaks(g_inst);
+}
+
+break_hit* getBreakHit() {
+	return tgbGetBreakHit(g_inst);
+}
+
+void resumeBreak() {
+	tgbResumeBreak(g_inst);
+}
+
+// 以下はハンドルごとの操作 (JS からは tgbCreate の戻り値を渡す)
+void tgbReset(tgb_instance *inst) {
+	inst->g->reset();
+}
+
+// keys は A,B,SELECT,START,DOWN,UP,LEFT,RIGHT の順のビット (setKeys と同じ)
+void tgbSetKeys(tgb_instance *inst, int keys) {
+	inst->render->set_pad(keys & 0xff);
+}
+
+// 2 台を通信ケーブルでつなぐ (両方とも ROM を読み込んでおく)
+// 以後は a の tgbRunFrame で a,b をそれぞれ別スレッドで 1 フレームずつ進める
+bool tgbLink(tgb_instance *a, tgb_instance *b) {
+	if (!a || !b || a == b || !a->g || !b->g) {
+		return false;
+	}
+	tgbUnlink(a);
+	tgbUnlink(b);
+
+	link_cable *link = new link_cable(a->g, b->g);
+	a->link = b->link = link;
+	a->link_peer = b;
+	b->link_peer = a;
+	a->link_primary = true;
+	b->link_primary = false;
+	return true;
+}
+
+void tgbUnlink(tgb_instance *inst) {
+	if (!inst || !inst->link) {
+		return;
+	}
+	tgb_instance *peer = inst->link_peer;
+	delete inst->link;
+	inst->link = peer->link = NULL;
+	inst->link_peer = peer->link_peer = NULL;
+	inst->link_primary = peer->link_primary = false;
+}
+
+unsigned char* tgbGetFrame(tgb_instance *inst) {
+	return inst->render->get_bytes();
+}
+
+short* tgbGetAudio(tgb_instance *inst, int size) {
+	return inst->render->read_sound(size);
+}
+
+byte* tgbGetSram(tgb_instance *inst) {
+	return inst->g ? inst->g->get_rom()->get_sram() : (byte*)0;
+}
+
+// 実行中の回数 (TGB_COUNTERS を定義してビルドしていなければ 0)
+// ポインタは変わらないので、一度取っておいて毎フレーム読めばよい
+gb_counters* tgbGetCounters(tgb_instance *inst) {
+#ifdef TGB_COUNTERS
+	return inst->g ? inst->g->get_counters() : (gb_counters*)0;
+#else
+	return (gb_counters*)0;
+#endif
+}
+
+void tgbClearCounters(tgb_instance *inst) {
+	if (inst->g) {
+		inst->g->clear_counters();
+	}
+}
+
+// PC のサンプリング (TGB_PROFILE を定義してビルドしていなければ false)
+// interval はクロック数 (0 でやめる)。ROM を読み込んでから呼ぶ
+bool tgbSetProfile(tgb_instance *inst, int interval) {
+	if (!inst->g) {
+		return false;
+	}
+	inst->g->set_profile(interval);
+	return inst->g->get_profiler() != NULL;
+}
+
+void tgbClearProfile(tgb_instance *inst) {
+	if (inst->g && inst->g->get_profiler()) {
+		inst->g->get_profiler()->clear();
+	}
+}
+
+// .sym を読んでレポートにルーチン名を付ける
+bool tgbLoadProfileSym(tgb_instance *inst, char *path) {
+	profiler *prof = inst->g ? inst->g->get_profiler() : NULL;
+	FILE *file = prof ? fopen(path, "rb") : NULL;
+	if (!file) {
+		return false;
+	}
+	std::string text;
+	char buf[4096];
+	size_t size;
+	while ((size = fread(buf, 1, sizeof(buf), file)) > 0) {
+		text.append(buf, size);
+	}
+	fclose(file);
+	return prof->load_sym(text.c_str());
+}
+
+// 多い順に maxLines 行ずつ (ルーチンごと、アドレスごと) 書き出す
+bool tgbSaveProfileReport(tgb_instance *inst, char *path, int maxLines) {
+	profiler *prof = inst->g ? inst->g->get_profiler() : NULL;
+	return prof ? prof->save_report(path, maxLines) : false;
+}
+
+// 命令トレース (リングバッファ)。saveTrace の出力は tgb_trace で読む
+void tgbSetTrace(tgb_instance *inst, bool enable) {
+	if (inst->g) {
+		inst->g->get_cpu()->set_trace(enable);
+	}
+}
+
+void tgbSetTraceSize(tgb_instance *inst, int records) {
+	if (inst->g && records > 0) {
+		inst->g->get_cpu()->set_trace_size(records);
+	}
+}
+
+void tgbClearTrace(tgb_instance *inst) {
+	trace_ring *trace = inst->g ? inst->g->get_cpu()->get_trace() : NULL;
+	if (trace) {
+		trace->clear();
+	}
+}
+
+bool tgbSaveTrace(tgb_instance *inst, char *path) {
+	trace_ring *trace = inst->g ? inst->g->get_cpu()->get_trace() : NULL;
+	return trace ? trace->save(path) : false;
+}
+
+// ブレークポイント (bank が -1 ならどのバンクでも) とウォッチポイント (type は 2:読み 4:書き)
+// 当たると runFrames はそのフレームの終わりで止まり、tgbGetBreakHit で最初に当たった所が読める
+int tgbAddBreakpoint(tgb_instance *inst, int pc, int bank) {
+	return inst->g ? inst->g->get_debugger()->add_break(pc & 0xffff, bank) : -1;
+}
+
+int tgbAddWatchpoint(tgb_instance *inst, int start, int end, int type) {
+	return inst->g ? inst->g->get_debugger()->add_watch(start & 0xffff, end & 0xffff, type) : -1;
+}
+
+bool tgbRemoveBreak(tgb_instance *inst, int id) {
+	return inst->g ? inst->g->get_debugger()->remove(id) : false;
+}
+
+void tgbClearBreaks(tgb_instance *inst) {
+	if (inst->g) {
+		inst->g->get_debugger()->clear();
+	}
+}
+
+// 当たっていなければ 0
+break_hit* tgbGetBreakHit(tgb_instance *inst) {
+	return inst->g ? inst->g->get_debugger()->get_hit() : (break_hit*)0;
+}
+
+void tgbResumeBreak(tgb_instance *inst) {
+	if (inst->g) {
+		inst->g->get_debugger()->resume();
+	}
+}
+
+unsigned char* getBytes() {
+	return tgbGetFrame(g_inst);
+}
+
+short* getSoundBytes(int size) {
+	return tgbGetAudio(g_inst, size);
+}
+
+float* tgbGetAudioF(tgb_instance *inst, int size) {
+	return inst->render->read_sound_f(size);
+}
+
+float* getSoundBytesF(int size) {
+	return tgbGetAudioF(g_inst, size);
+}
+
+int tgbGetSoundFill(tgb_instance *inst) {
+	return inst->render->get_sound_ring()->get_fill();
+}
+
+int getSoundFill() {
+	return tgbGetSoundFill(g_inst);
+}
+
+void tgbEnableSoundStems(tgb_instance *inst, bool enable) {
+	inst->render->set_stems(enable);
+}
+
+void enableSoundStems(bool enable) {
+	tgbEnableSoundStems(g_inst, enable);
+}
+
+// SQ1,SQ2,WAV,NOI の順に size サンプルずつ並べて返す
+short* tgbGetSoundStems(tgb_instance *inst, int size) {
+	return inst->render->read_stems(size);
+}
+
+short* getSoundStems(int size) {
+	return tgbGetSoundStems(g_inst, size);
+}
+
+void setKeys(int down, int up, int left, int right, int a, int b, int select, int start) {
+	if (start > 0) {
+		start = 1;
+	}
+	
+	int keys =	((down & 1) << 4) |
+			((up & 1) << 5) | 
+			((left & 1) << 6) | 
+			((right & 1) << 7) | 
+			((start & 1) << 3) | 
+			((select & 1) << 2) |
+			((b & 1) << 1) |
+			(a & 1);
+	tgbSetKeys(g_inst, keys);
+}
+
+// 画面を描画せずに frames フレーム分を一気に実行し、その間の音声をまとめて返す
+// サンプル数はエミュレーション時間から決まるので、実時間で録音したものと同じ長さになる
+int tgbRenderAudio(tgb_instance *inst, int frames) {
+	inst->offline_sound.clear();
+	if (!inst->g || frames <= 0) {
+		return 0;
+	}
+
+	bool lcd_enable = inst->g->get_lcd_enable();
+	bool sound_enable = inst->g->get_apu()->get_sound_enable();
+	inst->g->set_lcd_enable(false);
+	offline_audio_begin(inst, frames);
+	for (int i = 0; i < frames; i++) {
+		for (int line = 0; line < 154; line++) {
+			inst->g->run();
+		}
+		offline_audio_frame(inst);
+	}
+
+	inst->g->set_lcd_enable(lcd_enable);
+	inst->g->get_apu()->set_sound_enable(sound_enable);
+	return inst->offline_sound.size() / 2;
+}
+
+int renderAudio(int frames) {
+	return tgbRenderAudio(g_inst, frames);
+}
+
+// tgbRenderAudio (と tgbRunFrames の RUN_AUDIO) の結果 (L/R 交互の 16bit, 44100Hz)
+short* tgbGetRenderedAudio(tgb_instance *inst) {
+	if (inst->offline_sound.empty()) {
+		return (short*)0;
+	}
+	return &inst->offline_sound[0];
+}
+
+short* getRenderedAudio() {
+	return tgbGetRenderedAudio(g_inst);
+}
+
+void tgbEnableSound(tgb_instance *inst, bool enable) {
+	if (!inst->g) {
+		return;
+	}
+	// 無効にするとレジスタの状態だけを維持して波形生成を省略する
+	inst->g->get_apu()->set_sound_enable(enable);
+}
+
+void enableSound(bool enable) {
+	tgbEnableSound(g_inst, enable);
+}
+
+void tgbEnableSoundChannel(tgb_instance *inst, int ch, bool enable) {
+	if (!inst->g || ch < 0 || ch > 3) {
+		return;
+	}
+	inst->g->get_apu()->get_renderer()->set_enable(ch, enable);
+}
+
 void enableSoundChannel(int ch, bool enable) {
-	if (ch < 0 || ch > 3) {
+	tgbEnableSoundChannel(g_inst, ch, enable);
+}
+
+void tgbEnableSoundEcho(tgb_instance *inst, bool enable) {
+	if (!inst->g) {
 		return;
 	}
-	g_gb[0]->get_apu()->get_renderer()->set_enable(ch, enable);
+	inst->g->get_apu()->get_renderer()->set_echo(enable);
 }
 
 void enableSoundEcho(bool enable) {
-	g_gb[0]->get_apu()->get_renderer()->set_echo(enable);
+	tgbEnableSoundEcho(g_inst, enable);
+}
+
+void tgbEnableSoundLowPass(tgb_instance *inst, bool enable) {
+	if (!inst->g) {
+		return;
+	}
+	inst->g->get_apu()->get_renderer()->set_lowpass(enable);
 }
 
 void enableSoundLowPass(bool enable) {
-	g_gb[0]->get_apu()->get_renderer()->set_lowpass(enable);
+	tgbEnableSoundLowPass(g_inst, enable);
 }
 
-void enableScreenLayer(int layer, bool enable) {
-	if (layer < 0 || layer > 2) {
+void tgbEnableScreenLayer(tgb_instance *inst, int layer, bool enable) {
+	if (!inst->g || layer < 0 || layer > 2) {
 		return;
 	}
-	g_gb[0]->get_lcd()->set_enable(layer, enable);
+	inst->g->get_lcd()->set_enable(layer, enable);
 }
 
-void setGBType(int type) {
-	// Auto:0, GB:1, GBC:3, GBA:4
+void enableScreenLayer(int layer, bool enable) {
+	tgbEnableScreenLayer(g_inst, layer, enable);
+}
+
+// 次の tgbLoadRom から使う。Auto:0, GB:1, GBC:3, GBA:4
+void tgbSetGBType(tgb_instance *inst, int type) {
 	if (type < 0 || type > 4) {
 		return;
 	}
-	gb_type = type;
+	inst->gb_type = type;
+}
+
+void setGBType(int type) {
+	tgbSetGBType(g_inst, type);
 }
 
 #ifdef __cplusplus
@@ -1,103 +1,187 @@
 ﻿#include "web_renderer.h"
+#include "../gb_core/bench.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
 #include <time.h>
-#include "exports.h"
 
-#ifdef __cplusplus
-	extern "C" {
-#endif
+#define SOUND_RING_FRAMES 4096 // 約93ms (44.1kHz)
+#define SOUND_FRAME_SAMPLES (44100.0*70224.0/4194304.0) // 1フレーム(70224クロック)あたりのサンプル数
 
-extern void jsLog(const char *message);
+extern "C" void jsLog(const char *message);
 
-unsigned char* bytes;
-short* soundBytes;
-float* soundBytesF;
-unsigned int map_24[0x10000];
-unsigned char keys;
+// RGB565 -> RGBA (読むだけなので全インスタンスで共有する)
+static unsigned int map_24[0x10000];
 
-//sound_renderer *snd_render2;
-web_renderer *self;
-
-
-unsigned char* getBytes() {
-	return bytes;
-}
-
-short* getSoundBytes(int size) {
-	if (!self->snd_render) {
-		return (short*)0;
-	}
-	self->snd_render->render((short*)soundBytes, size);
-	return soundBytes;
-}
-
-float* getSoundBytesF(int size) {
-	if (!self->snd_render) {
-		return (float*)0;
-	}
-	short data[size * 2];
-	self->snd_render->render((short*)data, size);
-	for (int i = 0; i < size * 2; i++) {
-		soundBytesF[i] = (float)data[i] / 32768.0;
-	}
-	return soundBytesF;
-}
-
-void setKeys(int down, int up, int left, int right, int a, int b, int select, int start) {
-	if (start > 0) {
-		start = 1;
+static bool init_map_24()
+{
+	for (int i=0;i<0x10000;i++){
+		//map_24[i]=0xFF000000 | ((i&0xf800)<<8)|((i&0x7c0)<<5)|((i&0x3f)<<2);
+		map_24[i]=0xFF000000 | ((i&0xf800)>>8)|((i&0x7c0)<<5)|((i&0x3f)<<18);
 	}
-	
-	keys = 0;
-	keys |=	((down & 1) << 4) |
-			((up & 1) << 5) | 
-			((left & 1) << 6) | 
-			((right & 1) << 7) | 
-			((start & 1) << 3) | 
-			((select & 1) << 2) |
-			((b & 1) << 1) |
-			(a & 1);
+	return true;
 }
 
-#ifdef __cplusplus
-	}
-#endif
+static bool b_map_24=init_map_24();
 
 web_renderer::web_renderer()
 {
-	self = this;
 	key_state=0;
 	cur_time=0;
+	fixed_time=0;
 	color_type=2; 
 	
 	bytes = (unsigned char*)malloc(160 * 144 * 4);
-	soundBytes = (short*)malloc(2048 * 2 * 4);
-	soundBytesF = (float*)malloc(4096 * 2 * 4);
+	sound_bytes = (short*)malloc(2048 * 2 * 4);
+	sound_bytes_f = (float*)malloc(4096 * 2 * 4);
+
+	snd_ring = new sound_ring(SOUND_RING_FRAMES, 2);
+	snd_tmp = (short*)malloc(2048 * 2 * 2);
+
+	b_stems = false;
+	stem_bytes = (short*)malloc(2048 * 4 * 2);
+	for (int ch = 0; ch < 4; ch++) {
+		stem_ring[ch] = new sound_ring(SOUND_RING_FRAMES, 1);
+		stem_tmp[ch] = (short*)malloc(2048 * 2);
+	}
 	
 	//snd_render = NULL;
 	//snd_render2 = NULL;
-	
-	for (int i=0;i<0x10000;i++){
-		//map_24[i]=0xFF000000 | ((i&0xf800)<<8)|((i&0x7c0)<<5)|((i&0x3f)<<2);
-		map_24[i]=0xFF000000 | ((i&0xf800)>>8)|((i&0x7c0)<<5)|((i&0x3f)<<18);
-	}
 }
 
 web_renderer::~web_renderer()
 {
 	free(bytes);
-	free(soundBytes);
-	free(soundBytesF);
+	free(sound_bytes);
+	free(sound_bytes_f);
+	free(snd_tmp);
+	delete snd_ring;
+
+	free(stem_bytes);
+	for (int ch = 0; ch < 4; ch++) {
+		free(stem_tmp[ch]);
+		delete stem_ring[ch];
+	}
 }
 
 void web_renderer::reset() {
 	memset(bytes, 0, 160 * 144 * 4);
-	memset(soundBytes, 0, 2048 * 2 * 4);
+	memset(sound_bytes, 0, 2048 * 2 * 4);
+	snd_ring->clear();
+	for (int ch = 0; ch < 4; ch++) {
+		stem_ring[ch]->clear();
+	}
+}
+
+// ステム出力の切り替え
+// ミックスと同じ量ずつ積むので、有効にした時点で読み出し位置を揃えておく
+void web_renderer::set_stems(bool enable)
+{
+	if (enable && !b_stems) {
+		for (int ch = 0; ch < 4; ch++) {
+			stem_ring[ch]->clear();
+		}
+	}
+	b_stems = enable;
+}
+
+// 1フレーム分の波形を生成してリングバッファに積む (エミュレーションスレッド側)
+int web_renderer::push_sound()
+{
+	if (!snd_render) {
+		return 0;
+	}
+	int size = snd_ring->next_request(SOUND_FRAME_SAMPLES);
+	if (size > 2048) {
+		size = 2048;
+	}
+	if (b_stems) {
+		// 1回の波形生成でミックスと各チャンネルを同時に得る
+		snd_render->render_stems(snd_tmp, stem_tmp, size);
+		for (int ch = 0; ch < 4; ch++) {
+			stem_ring[ch]->write(stem_tmp[ch], size);
+		}
+	} else {
+		snd_render->render(snd_tmp, size);
+	}
+	snd_ring->write(snd_tmp, size);
+	return size;
+}
+
+// リングバッファから取り出す (オーディオコールバック側)
+// 足りない分は無音で埋める
+int web_renderer::pull_sound(short *buf, int size)
+{
+	int ret = snd_ring->read(buf, size);
+	if (ret < size) {
+		memset(buf + ret * 2, 0, (size - ret) * 2 * 2);
+	}
+	return ret;
+}
+
+// 以下は pull_sound 等の結果を内部のバッファに取り出して返す (JS から読む用)
+short *web_renderer::read_sound(int size)
+{
+	if (!snd_render) {
+		return (short*)0;
+	}
+	if (size > 2048) {
+		size = 2048;
+	}
+	pull_sound(sound_bytes, size);
+	return sound_bytes;
+}
+
+float *web_renderer::read_sound_f(int size)
+{
+	if (!snd_render) {
+		return (float*)0;
+	}
+	if (size > 4096) {
+		size = 4096;
+	}
+	short data[4096 * 2];
+	pull_sound(data, size);
+	for (int i = 0; i < size * 2; i++) {
+		sound_bytes_f[i] = (float)data[i] / 32768.0;
+	}
+	return sound_bytes_f;
+}
+
+// SQ1,SQ2,WAV,NOI の順に size サンプルずつ並べて返す
+short *web_renderer::read_stems(int size)
+{
+	if (!snd_render || !b_stems) {
+		return (short*)0;
+	}
+	if (size > 2048) {
+		size = 2048;
+	}
+	pull_stems(stem_bytes, size);
+	return stem_bytes;
+}
+
+// 各チャンネルのリングから size サンプルずつ buf に並べて取り出す
+int web_renderer::pull_stems(short *buf, int size)
+{
+	int ret = size;
+	for (int ch = 0; ch < 4; ch++) {
+		short *dat = buf + ch * size;
+		int len = stem_ring[ch]->read(dat, size);
+		if (len < size) {
+			memset(dat + len, 0, (size - len) * 2);
+		}
+		if (len < ret) {
+			ret = len;
+		}
+	}
+	return ret;
 }
 
 void web_renderer::render_screen(byte *buf,int width,int height,int depth)
 {
+	BENCH_SCOPE(BENCH_SCREEN);
 	int i,j;
 	word* wbuf = (word*)buf;
 	unsigned int* dbytes = (unsigned int*)bytes;
@@ -165,14 +249,7 @@ void web_renderer::set_pad(int stat)
 
 int web_renderer::check_pad()
 {
-	static bool test = false;
-	test = !test;
-	
-	//if (test) {
-		return keys;
-	//}
-	
-	//return key_state;
+	return key_state;
 }
 
 int web_renderer::get_timer_state()
@@ -180,6 +257,17 @@ int web_renderer::get_timer_state()
 	return cur_time;
 }
 
+void web_renderer::set_timer_state(int timer)
+{
+	cur_time=timer;
+}
+
+// RTC の基準時刻 (秒)
+void web_renderer::set_fixed_time(dword time)
+{
+	fixed_time=time;
+}
+
 byte web_renderer::get_time(int type)
 {
 	dword now=fixed_time-cur_time;
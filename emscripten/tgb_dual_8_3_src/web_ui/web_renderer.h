@@ -1,4 +1,5 @@
 ﻿#include "../gb_core/renderer.h"
+#include "../gb_core/sound_ring.h"
 #include <stdio.h>
 #include <vector>
 
@@ -25,6 +26,7 @@ public:
 	word get_sensor(bool x_y) { return 0; }
 	void output_log(char *mes,...);
 	int get_timer_state();
+	void set_timer_state(int timer);
 	byte get_time(int type);
 	void set_time(int type,byte dat);
 	void set_bibrate(bool bibrate) {};
@@ -34,8 +36,22 @@ public:
 	int check_pad();
 	void set_pad(int state);
 	void set_fixed_time(dword time);
+	dword get_fixed_time() { return fixed_time; }
 
 	void set_filter(col_filter *fil) { m_filter=*fil; };
+
+	int push_sound(); // 積んだサンプル数
+	int pull_sound(short *buf,int size);
+	int pull_stems(short *buf,int size);
+	sound_ring *get_sound_ring() { return snd_ring; }
+
+	void set_stems(bool enable);
+	bool get_stems() { return b_stems; }
+
+	unsigned char *get_bytes() { return bytes; } // RGBA 160x144
+	short *read_sound(int size);
+	float *read_sound_f(int size);
+	short *read_stems(int size);
 private:
 	int key_state;
 	int cur_time;
@@ -43,4 +59,16 @@ private:
 	col_filter m_filter;
 	
 	int color_type;
+
+	sound_ring *snd_ring;
+	short *snd_tmp;
+
+	bool b_stems;
+	sound_ring *stem_ring[4]; // SQ1,SQ2,WAV,NOI (モノラル)
+	short *stem_tmp[4];
+
+	unsigned char *bytes;
+	short *sound_bytes;
+	float *sound_bytes_f;
+	short *stem_bytes;
 };
@@ -32,6 +32,14 @@ export class TgbDual extends EventEmitter {
 
 	protected _log: string[] = [];
 
+	// Files in /data that the writer has been asked to write and that
+	// still have to be copied to pathConfig.save.
+	protected _unsavedFiles: Set<string> = new Set();
+	protected _persistTimer: any = null;
+	protected _autoSaveFileName: string = null;
+	protected _autoSaveTimer: any = null;
+	protected _autoSaveTime: number = 0;
+
 	public static get isInitialized(): boolean {
 		return _isInitialized;
 	}
@@ -118,6 +126,7 @@ export class TgbDual extends EventEmitter {
 
 	public destroy(): void {
 		this._waveFileWriter.close();
+		this.flushSaves();
 	}
 
 	public start(): void {
@@ -172,19 +181,9 @@ export class TgbDual extends EventEmitter {
 		if (saveFileName.length <= 4) {
 			return;
 		}
-		
-		if (!fs.existsSync(this.pathConfig.save)) {
-			fs.mkdirSync(this.pathConfig.save);
-		}
-
-		TgbDual.API.saveSram("/data/sram_tmp.sav");
-		const data = Module.FS.readFile("/data/sram_tmp.sav", {
-			encoding: "binary", flags: "r"
-		});
-		Module.FS.unlink("/data/sram_tmp.sav");
 
-		const saveFilePath = path.join(this.pathConfig.save, saveFileName);
-		fs.writeFileSync(saveFilePath, data);
+		TgbDual.API.saveSramAsync("/data/" + saveFileName);
+		this.persistSave(saveFileName);
 
 		/*
 		const pointer = TgbDual.API.getSram();
@@ -257,22 +256,13 @@ export class TgbDual extends EventEmitter {
 		}
 
 		index = Math.floor(index);
-		TgbDual.API.saveState("/data/save_tmp.sav");
-		const data = Module.FS.readFile("/data/save_tmp.sav", {
-			encoding: "binary", flags: "r"
-		});
-		Module.FS.unlink("/data/save_tmp.sav");
-
 		const pathInfo = path.parse(this.romPath);
 		const saveFileName = pathInfo.name + ".sv" + index;
 		if (saveFileName.length <= 4) {
 			return;
 		}
-		if (!fs.existsSync(this.pathConfig.save)) {
-			fs.mkdirSync(this.pathConfig.save);
-		}
-		const saveFilePath = path.join(this.pathConfig.save, saveFileName);
-		fs.writeFileSync(saveFilePath, data);
+		TgbDual.API.saveStateAsync("/data/" + saveFileName);
+		this.persistSave(saveFileName);
 	}
 
 	public restoreState(index: number): void {
@@ -296,11 +286,10 @@ export class TgbDual extends EventEmitter {
 		}
 		const data = fs.readFileSync(saveFilePath);
 
-		Module.FS.writeFile("/data/load_tmp.sav", data, {
-			encoding: "binary", flags: "w"
-		});
-		TgbDual.API.restoreState("/data/load_tmp.sav");
-		Module.FS.unlink("/data/load_tmp.sav");
+		const pointer = Module._malloc(data.length);
+		Module.HEAPU8.set(data, pointer);
+		TgbDual.API.restoreStateMem(pointer, data.length);
+		Module._free(pointer);
 	}
 
 	public setGBType(type: string): void {
@@ -366,6 +355,148 @@ export class TgbDual extends EventEmitter {
 		TgbDual.API.nextFrame();
 	}
 
+	// Runs several frames in one call. flags is a combination of
+	// TgbDual.RunRenderLast, TgbDual.RunAudio and TgbDual.RunNoSound.
+	// With RunAudio the sound of the span is read with getRenderedAudio.
+	public runFrames(frames: number, flags: number = 0): TgbDual.RunStatus {
+		const pointer = TgbDual.API.runFrames(frames, flags) / 4;
+		const status = new TgbDual.RunStatus();
+		status.frames = Module.HEAP32[pointer];
+		status.samples = Module.HEAP32[pointer + 1];
+		status.vblanks = Module.HEAP32[pointer + 2];
+		status.hit = Module.HEAP32[pointer + 3] != 0;
+		return status;
+	}
+
+	// Returns the counters accumulated since clearCounters,
+	// or null when the core was built without TGB_COUNTERS.
+	public getCounters(): TgbDual.Counters {
+		const pointer = TgbDual.API.getCounters() / 4;
+		if (pointer === 0) {
+			return null;
+		}
+		const heap = Module.HEAPU32;
+		const counters = new TgbDual.Counters();
+		counters.instructions = heap[pointer];
+		counters.opcodes = Array.from(heap.subarray(pointer + 1, pointer + 257));
+		counters.opcodesCb = Array.from(heap.subarray(pointer + 257, pointer + 513));
+		counters.reads = Array.from(heap.subarray(pointer + 513, pointer + 521));
+		counters.writes = Array.from(heap.subarray(pointer + 521, pointer + 529));
+		counters.romBankSwitches = heap[pointer + 529];
+		counters.ramBankSwitches = heap[pointer + 530];
+		counters.hdmaBytes = heap[pointer + 531];
+		counters.apuWrites = heap[pointer + 532];
+		counters.interrupts = Array.from(heap.subarray(pointer + 533, pointer + 538));
+		counters.linesRendered = heap[pointer + 538];
+		counters.linesSkipped = heap[pointer + 539];
+		return counters;
+	}
+
+	public clearCounters(): void {
+		TgbDual.API.clearCounters();
+	}
+
+	// Samples the guest PC every `interval` clocks (0 stops).
+	// Returns false when the core was built without TGB_PROFILE.
+	public setProfile(interval: number): boolean {
+		return TgbDual.API.setProfile(interval);
+	}
+
+	public clearProfile(): void {
+		TgbDual.API.clearProfile();
+	}
+
+	// Optional symbol file ("BB:AAAA name" per line) used to name routines in the report.
+	public loadProfileSym(symFilePath: string): boolean {
+		const data = fs.readFileSync(symFilePath);
+		Module.FS.writeFile("/data/profile_tmp.sym", data, { encoding: "binary" });
+		const result = TgbDual.API.loadProfileSym("/data/profile_tmp.sym");
+		Module.FS.unlink("/data/profile_tmp.sym");
+		return result;
+	}
+
+	public getProfileReport(maxLines: number = 100): string {
+		if (!TgbDual.API.saveProfileReport("/data/profile_tmp.txt", maxLines)) {
+			return null;
+		}
+		const report = Module.FS.readFile("/data/profile_tmp.txt", { encoding: "utf8" });
+		Module.FS.unlink("/data/profile_tmp.txt");
+		return report;
+	}
+
+	// Keeps the last `records` instructions (PC, bank, registers) in a ring buffer.
+	public setTrace(enable: boolean, records: number = 0): void {
+		if (records > 0) {
+			TgbDual.API.setTraceSize(records);
+		}
+		TgbDual.API.setTrace(enable);
+	}
+
+	public clearTrace(): void {
+		TgbDual.API.clearTrace();
+	}
+
+	// Writes the ring buffer in binary; decode it with tgb_trace.
+	public saveTrace(traceFilePath: string): boolean {
+		if (!TgbDual.API.saveTrace("/data/trace_tmp.bin")) {
+			return false;
+		}
+		const data = Module.FS.readFile("/data/trace_tmp.bin", {
+			encoding: "binary", flags: "r"
+		});
+		Module.FS.unlink("/data/trace_tmp.bin");
+		fs.writeFileSync(traceFilePath, data);
+		return true;
+	}
+
+	// While any breakpoint or watchpoint is set, runFrames stops at the end of
+	// the frame in which the first one was hit (status.hit). Returns the id.
+	public addBreakpoint(pc: number, bank: number = TgbDual.BreakAnyBank): number {
+		return TgbDual.API.addBreakpoint(pc, bank);
+	}
+
+	// type is TgbDual.BreakRead and/or TgbDual.BreakWrite. end is inclusive.
+	public addWatchpoint(start: number, end: number, type: number): number {
+		return TgbDual.API.addWatchpoint(start, end, type);
+	}
+
+	public removeBreak(id: number): boolean {
+		return TgbDual.API.removeBreak(id);
+	}
+
+	public clearBreaks(): void {
+		TgbDual.API.clearBreaks();
+	}
+
+	// Returns the first hit since resumeBreak, or null.
+	public getBreakHit(): TgbDual.BreakHit {
+		const pointer = TgbDual.API.getBreakHit() / 4;
+		if (pointer == 0) {
+			return null;
+		}
+		const heap = Module.HEAP32;
+		const hit = new TgbDual.BreakHit();
+		hit.id = heap[pointer];
+		hit.type = heap[pointer + 1];
+		hit.pc = heap[pointer + 2];
+		hit.bank = heap[pointer + 3];
+		hit.address = heap[pointer + 4];
+		hit.data = heap[pointer + 5];
+		hit.line = heap[pointer + 6];
+		hit.clock = heap[pointer + 7];
+		hit.af = heap[pointer + 8];
+		hit.bc = heap[pointer + 9];
+		hit.de = heap[pointer + 10];
+		hit.hl = heap[pointer + 11];
+		hit.sp = heap[pointer + 12];
+		hit.count = heap[pointer + 13];
+		return hit;
+	}
+
+	public resumeBreak(): void {
+		TgbDual.API.resumeBreak();
+	}
+
 	public setKeys(keyState: TgbDual.KeyState): void {
 		keyState.update();
 		const down = keyState.down ? 1 : 0;
@@ -386,6 +517,7 @@ export class TgbDual extends EventEmitter {
 	public setSound(master: boolean, square1: boolean, square2: boolean, wave: boolean, noise: boolean) {
 		console.log("setSound", master);
 		this._soundPlayer.isMuted = !master;
+		TgbDual.API.enableSound(master);
 		TgbDual.API.enableSoundChannel(0, square1);
 		TgbDual.API.enableSoundChannel(1, square2);
 		TgbDual.API.enableSoundChannel(2, wave);
@@ -397,6 +529,73 @@ export class TgbDual extends EventEmitter {
 		TgbDual.API.enableSoundLowPass(lowPass);
 	}
 	
+	// Saves a state every `seconds` seconds. Only the snapshot is taken
+	// on the frame; the file is written into /data afterwards and then
+	// copied to pathConfig.save. 0 turns it off.
+	public setAutoSave(fileName: string, seconds: number): void {
+		if (this._autoSaveTimer != null) {
+			clearInterval(this._autoSaveTimer);
+			this._autoSaveTimer = null;
+		}
+		if (seconds <= 0 || fileName == null || fileName === "") {
+			TgbDual.API.setAutoSave(null, 0);
+			this._autoSaveFileName = null;
+			return;
+		}
+		TgbDual.API.setAutoSave("/data/" + fileName, Math.round(seconds * 60));
+		this._autoSaveFileName = fileName;
+		this._autoSaveTime = this.getDataFileTime(fileName);
+		this._autoSaveTimer = setInterval(this.onAutoSaveTimer, 1000);
+	}
+
+	// Writes out everything the writer still holds and copies it to
+	// pathConfig.save before returning. Used when the app is closing.
+	public flushSaves(): void {
+		TgbDual.API.flushSaves();
+		if (this._autoSaveFileName != null) {
+			this.onAutoSaveTimer();
+		}
+		if (this._persistTimer != null) {
+			clearTimeout(this._persistTimer);
+			this._persistTimer = null;
+		}
+		if (this._unsavedFiles.size <= 0 || this.pathConfig == null) {
+			return;
+		}
+		if (!fs.existsSync(this.pathConfig.save)) {
+			fs.mkdirSync(this.pathConfig.save);
+		}
+		this._unsavedFiles.forEach((fileName) => {
+			const data = this.readDataFile(fileName);
+			if (data != null) {
+				fs.writeFileSync(path.join(this.pathConfig.save, fileName), data);
+			}
+		});
+		this._unsavedFiles.clear();
+		Module.FS.syncfs(false, (err) => {
+			if (err) {
+				console.log(err);
+			}
+		});
+	}
+
+	// Compresses save states and .sav files written from now on.
+	// Both compressed and plain files can always be loaded.
+	public setSaveCompression(enable: boolean): void {
+		TgbDual.API.setSaveCompression(enable);
+	}
+
+	// Runs the given number of frames without drawing and returns
+	// the audio of that span (interleaved L/R, 44100Hz).
+	public renderAudio(frames: number): Int16Array {
+		const samples = TgbDual.API.renderAudio(frames);
+		if (samples <= 0) {
+			return new Int16Array(0);
+		}
+		const pointer = TgbDual.API.getRenderedAudio() / 2;
+		return Module.HEAP16.slice(pointer, pointer + samples * 2);
+	}
+
 	public enableScreenLayer(layer: number | string, enable: boolean) {
 		console.log("enableScreenLayer", layer, enable);
 		let layerIndex = 0;
@@ -439,6 +638,77 @@ export class TgbDual extends EventEmitter {
 		});
 	}
 
+	// Copies /data/fileName to pathConfig.save once the writer has
+	// written it. Nothing is read or written on the frame itself.
+	protected persistSave(fileName: string): void {
+		this._unsavedFiles.add(fileName);
+		if (this._persistTimer == null) {
+			this._persistTimer = setTimeout(this.onPersistTimer, 0);
+		}
+	}
+
+	protected onPersistTimer = (): void => {
+		this._persistTimer = null;
+		if (TgbDual.API.getPendingSaves() > 0) {
+			this._persistTimer = setTimeout(this.onPersistTimer, 10);
+			return;
+		}
+		Module.FS.syncfs(false, (err) => {
+			if (err) {
+				console.log(err);
+			}
+		});
+		if (this.pathConfig == null) {
+			this._unsavedFiles.clear();
+			return;
+		}
+		if (!fs.existsSync(this.pathConfig.save)) {
+			fs.mkdirSync(this.pathConfig.save);
+		}
+		this._unsavedFiles.forEach((fileName) => {
+			const data = this.readDataFile(fileName);
+			if (data == null) {
+				return;
+			}
+			const saveFilePath = path.join(this.pathConfig.save, fileName);
+			fs.writeFile(saveFilePath, data, (err) => {
+				if (err) {
+					console.log(err);
+				}
+			});
+		});
+		this._unsavedFiles.clear();
+	}
+
+	// The writer does not tell when an auto save has been taken,
+	// so the file time in /data is checked instead.
+	protected onAutoSaveTimer = (): void => {
+		const time = this.getDataFileTime(this._autoSaveFileName);
+		if (time > this._autoSaveTime) {
+			this._autoSaveTime = time;
+			this.persistSave(this._autoSaveFileName);
+		}
+	}
+
+	protected getDataFileTime(fileName: string): number {
+		try {
+			const stat = Module.FS.stat("/data/" + fileName);
+			return new Date(stat.mtime).getTime();
+		} catch (e) {
+			return 0;
+		}
+	}
+
+	protected readDataFile(fileName: string): Uint8Array {
+		try {
+			return Module.FS.readFile("/data/" + fileName, {
+				encoding: "binary", flags: "r"
+			});
+		} catch (e) {
+			return null;
+		}
+	}
+
 	protected onCanvasUpdate = (time: number): void => {
 		this.emit("update");
 		this.setKeys(this.keyState);
@@ -525,6 +795,31 @@ export module TgbDual {
 	export const ScreenBufferSize = TgbDual.Width * TgbDual.Height * 4;
 	export const ScreenRatio = TgbDual.Width / TgbDual.Height;
 
+	// runFrames flags
+	export const RunRenderLast = 1;
+	export const RunAudio = 2;
+	export const RunNoSound = 4;
+
+	// compareHashLogs result when the logs cannot be compared
+	// (missing file, bad magic or different header). -1 means identical.
+	export const HashLogError = -2;
+
+	// Counters.reads / Counters.writes index
+	export const RegionRom0 = 0;
+	export const RegionRomX = 1;
+	export const RegionVram = 2;
+	export const RegionSram = 3;
+	export const RegionWram = 4;
+	export const RegionOam = 5;
+	export const RegionIo = 6;
+	export const RegionHram = 7;
+
+	// BreakHit.type / addWatchpoint type
+	export const BreakExec = 1;
+	export const BreakRead = 2;
+	export const BreakWrite = 4;
+	export const BreakAnyBank = -1;
+
 	export function oninit() {
 	};
 
@@ -532,9 +827,44 @@ export module TgbDual {
 		public static initTgbDual: () => void;
 		public static loadRom: (size: number, data: any, sramSize: number, sram: any) => void;
 		public static nextFrame: () => void;
+		public static runFrames: (frames: number, flags: number) => number;
+		public static getCounters: () => number;
+		public static clearCounters: () => void;
+		public static setProfile: (interval: number) => boolean;
+		public static clearProfile: () => void;
+		public static loadProfileSym: (path: string) => boolean;
+		public static saveProfileReport: (path: string, maxLines: number) => boolean;
+		public static setTrace: (enable: boolean) => void;
+		public static setTraceSize: (records: number) => void;
+		public static clearTrace: () => void;
+		public static saveTrace: (path: string) => boolean;
+		public static addBreakpoint: (pc: number, bank: number) => number;
+		public static addWatchpoint: (start: number, end: number, type: number) => number;
+		public static removeBreak: (id: number) => boolean;
+		public static clearBreaks: () => void;
+		public static getBreakHit: () => number;
+		public static resumeBreak: () => void;
+		public static setRunAhead: (frames: number) => void;
+		public static setRtcBase: (seconds: number) => void;
+		public static startMovieRecord: (fromState: boolean) => void;
+		public static saveMovie: (path: string) => boolean;
+		public static playMovie: (path: string) => boolean;
+		public static stopMovie: () => void;
+		public static getMovieMode: () => number;
+		public static getMovieFrame: () => number;
+		public static getMovieLength: () => number;
+		public static playMovieFast: (frames: number) => number;
+		public static startHashLog: (path: string) => boolean;
+		public static stopHashLog: () => void;
+		public static compareHashLogs: (pathA: string, pathB: string) => number;
+		public static getHashLogDiffPart: () => number;
+		public static getFrameHash: (part: number) => number;
 		public static getBytes: () => number;
 		public static getSoundBytes: (size: number) => number;
 		public static getSoundBytesF: (size: number) => number;
+		public static getSoundFill: () => number;
+		public static enableSoundStems: (enable: boolean) => void;
+		public static getSoundStems: (size: number) => number;
 		public static setKeys: (down: number, up: number, left: number, right: number, a: number, b: number, select: number, start: number) => void;
 		public static reset: () => void;
 		public static getCartName: () => string;
@@ -545,15 +875,107 @@ export module TgbDual {
 		public static getGBType: () => number;
 		public static saveState: (path: string) => void;
 		public static restoreState: (path: string) => void;
+		public static getStateSize: () => number;
+		public static saveStateMem: (pointer: number, size: number) => number;
+		public static restoreStateMem: (pointer: number, size: number) => boolean;
+		public static setRewind: (interval: number, capacity: number) => void;
+		public static rewindFrame: () => boolean;
+		public static getRewindCount: () => number;
 		public static setSkip: (frame: number) => void;
 		public static getSram: () => number;
 		public static saveSram: (path: string) => void;
+		public static saveStateAsync: (path: string) => void;
+		public static saveSramAsync: (path: string) => void;
+		public static flushSaves: () => void;
+		public static getPendingSaves: () => number;
+		public static setAutoSave: (path: string, frames: number) => void;
+		public static setSaveCompression: (enable: boolean) => void;
+		public static renderAudio: (frames: number) => number;
+		public static getRenderedAudio: () => number;
+		public static enableSound: (enable: boolean) => void;
 		public static enableSoundChannel: (ch: number, enable: boolean) => void;
 		public static enableSoundEcho: (enable: boolean) => void;
 		public static enableSoundLowPass: (enable: boolean) => void;
 		public static enableScreenLayer: (layer: number, enable: boolean) => void;
 		public static setGBType: (type: number) => void;
 
+		// instance handles (tgbCreate returns a pointer)
+		public static tgbCreate: () => number;
+		public static tgbDestroy: (inst: number) => void;
+		public static tgbLoadRom: (inst: number, size: number, data: any, sramSize: number, sram: any) => void;
+		public static tgbReset: (inst: number) => void;
+		public static tgbSetKeys: (inst: number, keys: number) => void;
+		public static tgbRunFrame: (inst: number) => void;
+		public static tgbRunFrames: (inst: number, frames: number, flags: number) => number;
+		public static tgbLink: (a: number, b: number) => boolean;
+		public static tgbUnlink: (inst: number) => void;
+		public static tgbGetFrame: (inst: number) => number;
+		public static tgbGetAudio: (inst: number, size: number) => number;
+		public static tgbGetSram: (inst: number) => number;
+		public static tgbGetStateSize: (inst: number) => number;
+		public static tgbSaveStateMem: (inst: number, buf: number, size: number) => number;
+		public static tgbRestoreStateMem: (inst: number, buf: number, size: number) => boolean;
+		public static tgbGetCounters: (inst: number) => number;
+		public static tgbClearCounters: (inst: number) => void;
+		public static tgbSetProfile: (inst: number, interval: number) => boolean;
+		public static tgbClearProfile: (inst: number) => void;
+		public static tgbLoadProfileSym: (inst: number, path: string) => boolean;
+		public static tgbSaveProfileReport: (inst: number, path: string, maxLines: number) => boolean;
+		public static tgbSetTrace: (inst: number, enable: boolean) => void;
+		public static tgbSetTraceSize: (inst: number, records: number) => void;
+		public static tgbClearTrace: (inst: number) => void;
+		public static tgbSaveTrace: (inst: number, path: string) => boolean;
+		public static tgbAddBreakpoint: (inst: number, pc: number, bank: number) => number;
+		public static tgbAddWatchpoint: (inst: number, start: number, end: number, type: number) => number;
+		public static tgbRemoveBreak: (inst: number, id: number) => boolean;
+		public static tgbClearBreaks: (inst: number) => void;
+		public static tgbGetBreakHit: (inst: number) => number;
+		public static tgbResumeBreak: (inst: number) => void;
+		public static tgbSaveState: (inst: number, path: string) => void;
+		public static tgbRestoreState: (inst: number, path: string) => void;
+		public static tgbSetRewind: (inst: number, interval: number, capacity: number) => void;
+		public static tgbRewindFrame: (inst: number) => boolean;
+		public static tgbGetRewindCount: (inst: number) => number;
+		public static tgbSetSkip: (inst: number, frame: number) => void;
+		public static tgbSaveSram: (inst: number, path: string) => void;
+		public static tgbSetSaveCompression: (inst: number, enable: boolean) => void;
+		public static tgbSaveStateAsync: (inst: number, path: string) => void;
+		public static tgbSaveSramAsync: (inst: number, path: string) => void;
+		public static tgbSetAutoSave: (inst: number, path: string, frames: number) => void;
+		public static tgbSetRunAhead: (inst: number, frames: number) => void;
+		public static tgbSetRtcBase: (inst: number, seconds: number) => void;
+		public static tgbStartMovieRecord: (inst: number, fromState: boolean) => void;
+		public static tgbSaveMovie: (inst: number, path: string) => boolean;
+		public static tgbPlayMovie: (inst: number, path: string) => boolean;
+		public static tgbStopMovie: (inst: number) => void;
+		public static tgbGetMovieMode: (inst: number) => number;
+		public static tgbGetMovieFrame: (inst: number) => number;
+		public static tgbGetMovieLength: (inst: number) => number;
+		public static tgbPlayMovieFast: (inst: number, frames: number) => number;
+		public static tgbStartHashLog: (inst: number, path: string) => boolean;
+		public static tgbStopHashLog: (inst: number) => void;
+		public static tgbCompareHashLogs: (inst: number, pathA: string, pathB: string) => number;
+		public static tgbGetHashLogDiffPart: (inst: number) => number;
+		public static tgbGetFrameHash: (inst: number, part: number) => number;
+		public static tgbGetCartName: (inst: number) => string;
+		public static tgbGetCartType: (inst: number) => number;
+		public static tgbGetRomSize: (inst: number) => number;
+		public static tgbGetRamSize: (inst: number) => number;
+		public static tgbGetCheckSum: (inst: number) => number;
+		public static tgbGetGBType: (inst: number) => number;
+		public static tgbGetAudioF: (inst: number, size: number) => number;
+		public static tgbGetSoundFill: (inst: number) => number;
+		public static tgbEnableSoundStems: (inst: number, enable: boolean) => void;
+		public static tgbGetSoundStems: (inst: number, size: number) => number;
+		public static tgbRenderAudio: (inst: number, frames: number) => number;
+		public static tgbGetRenderedAudio: (inst: number) => number;
+		public static tgbEnableSound: (inst: number, enable: boolean) => void;
+		public static tgbEnableSoundChannel: (inst: number, ch: number, enable: boolean) => void;
+		public static tgbEnableSoundEcho: (inst: number, enable: boolean) => void;
+		public static tgbEnableSoundLowPass: (inst: number, enable: boolean) => void;
+		public static tgbEnableScreenLayer: (inst: number, layer: number, enable: boolean) => void;
+		public static tgbSetGBType: (inst: number, type: number) => void;
+
 		public static init() {
 			this.initTgbDual = Module.cwrap(
 				"initTgbDual", "void", []);
@@ -561,12 +983,82 @@ export module TgbDual {
 				"loadRom", "void", ["number", "array", "number", "array"]);
 			this.nextFrame = Module.cwrap(
 				"nextFrame", "void", []);
+			this.runFrames = Module.cwrap(
+				"runFrames", "number", ["number", "number"]);
+			this.getCounters = Module.cwrap(
+				"getCounters", "number", []);
+			this.clearCounters = Module.cwrap(
+				"clearCounters", "void", []);
+			this.setProfile = Module.cwrap(
+				"setProfile", "boolean", ["number"]);
+			this.clearProfile = Module.cwrap(
+				"clearProfile", "void", []);
+			this.loadProfileSym = Module.cwrap(
+				"loadProfileSym", "boolean", ["string"]);
+			this.saveProfileReport = Module.cwrap(
+				"saveProfileReport", "boolean", ["string", "number"]);
+			this.setTrace = Module.cwrap(
+				"setTrace", "void", ["boolean"]);
+			this.setTraceSize = Module.cwrap(
+				"setTraceSize", "void", ["number"]);
+			this.clearTrace = Module.cwrap(
+				"clearTrace", "void", []);
+			this.saveTrace = Module.cwrap(
+				"saveTrace", "boolean", ["string"]);
+			this.addBreakpoint = Module.cwrap(
+				"addBreakpoint", "number", ["number", "number"]);
+			this.addWatchpoint = Module.cwrap(
+				"addWatchpoint", "number", ["number", "number", "number"]);
+			this.removeBreak = Module.cwrap(
+				"removeBreak", "boolean", ["number"]);
+			this.clearBreaks = Module.cwrap(
+				"clearBreaks", "void", []);
+			this.getBreakHit = Module.cwrap(
+				"getBreakHit", "number", []);
+			this.resumeBreak = Module.cwrap(
+				"resumeBreak", "void", []);
+			this.setRunAhead = Module.cwrap(
+				"setRunAhead", "void", ["number"]);
+			this.setRtcBase = Module.cwrap(
+				"setRtcBase", "void", ["number"]);
+			this.startMovieRecord = Module.cwrap(
+				"startMovieRecord", "void", ["boolean"]);
+			this.saveMovie = Module.cwrap(
+				"saveMovie", "boolean", ["string"]);
+			this.playMovie = Module.cwrap(
+				"playMovie", "boolean", ["string"]);
+			this.stopMovie = Module.cwrap(
+				"stopMovie", "void", []);
+			this.getMovieMode = Module.cwrap(
+				"getMovieMode", "number", []);
+			this.getMovieFrame = Module.cwrap(
+				"getMovieFrame", "number", []);
+			this.getMovieLength = Module.cwrap(
+				"getMovieLength", "number", []);
+			this.playMovieFast = Module.cwrap(
+				"playMovieFast", "number", ["number"]);
+			this.startHashLog = Module.cwrap(
+				"startHashLog", "boolean", ["string"]);
+			this.stopHashLog = Module.cwrap(
+				"stopHashLog", "void", []);
+			this.compareHashLogs = Module.cwrap(
+				"compareHashLogs", "number", ["string", "string"]);
+			this.getHashLogDiffPart = Module.cwrap(
+				"getHashLogDiffPart", "number", []);
+			this.getFrameHash = Module.cwrap(
+				"getFrameHash", "number", ["number"]);
 			this.getBytes = Module.cwrap(
 				"getBytes", "number", []);
 			this.getSoundBytes = Module.cwrap(
 				"getSoundBytes", "number", ["number"]);
 			this.getSoundBytesF = Module.cwrap(
 				"getSoundBytesF", "number", ["number"]);
+			this.getSoundFill = Module.cwrap(
+				"getSoundFill", "number", []);
+			this.enableSoundStems = Module.cwrap(
+				"enableSoundStems", "void", ["boolean"]);
+			this.getSoundStems = Module.cwrap(
+				"getSoundStems", "number", ["number"]);
 			this.setKeys = Module.cwrap(
 				"setKeys", "void", [
 					"number", "number", "number", "number",
@@ -590,12 +1082,42 @@ export module TgbDual {
 				"saveState", "void", ["string"]);
 			this.restoreState = Module.cwrap(
 				"restoreState", "void", ["string"]);
+			this.getStateSize = Module.cwrap(
+				"getStateSize", "number", []);
+			this.saveStateMem = Module.cwrap(
+				"saveStateMem", "number", ["number", "number"]);
+			this.restoreStateMem = Module.cwrap(
+				"restoreStateMem", "boolean", ["number", "number"]);
+			this.setRewind = Module.cwrap(
+				"setRewind", "void", ["number", "number"]);
+			this.rewindFrame = Module.cwrap(
+				"rewindFrame", "boolean", []);
+			this.getRewindCount = Module.cwrap(
+				"getRewindCount", "number", []);
 			this.setSkip = Module.cwrap(
 				"setSkip", "void", ["number"]);
 			this.getSram = Module.cwrap(
 				"getSram", "number", []);
 			this.saveSram = Module.cwrap(
 				"saveSram", "void", ["string"]);
+			this.saveStateAsync = Module.cwrap(
+				"saveStateAsync", "void", ["string"]);
+			this.saveSramAsync = Module.cwrap(
+				"saveSramAsync", "void", ["string"]);
+			this.flushSaves = Module.cwrap(
+				"flushSaves", "void", []);
+			this.getPendingSaves = Module.cwrap(
+				"getPendingSaves", "number", []);
+			this.setAutoSave = Module.cwrap(
+				"setAutoSave", "void", ["string", "number"]);
+			this.setSaveCompression = Module.cwrap(
+				"setSaveCompression", "void", ["boolean"]);
+			this.renderAudio = Module.cwrap(
+				"renderAudio", "number", ["number"]);
+			this.getRenderedAudio = Module.cwrap(
+				"getRenderedAudio", "number", []);
+			this.enableSound = Module.cwrap(
+				"enableSound", "void", ["boolean"]);
 			this.enableSoundChannel = Module.cwrap(
 				"enableSoundChannel", "void", ["number", "boolean"]);
 			this.enableSoundEcho = Module.cwrap(
@@ -606,6 +1128,157 @@ export module TgbDual {
 				"enableScreenLayer", "void", ["number", "boolean"]);
 			this.setGBType = Module.cwrap(
 				"setGBType", "void", ["number"]);
+
+			this.tgbCreate = Module.cwrap(
+				"tgbCreate", "number", []);
+			this.tgbDestroy = Module.cwrap(
+				"tgbDestroy", "void", ["number"]);
+			this.tgbLoadRom = Module.cwrap(
+				"tgbLoadRom", "void", ["number", "number", "array", "number", "array"]);
+			this.tgbReset = Module.cwrap(
+				"tgbReset", "void", ["number"]);
+			this.tgbSetKeys = Module.cwrap(
+				"tgbSetKeys", "void", ["number", "number"]);
+			this.tgbRunFrame = Module.cwrap(
+				"tgbRunFrame", "void", ["number"]);
+			this.tgbRunFrames = Module.cwrap(
+				"tgbRunFrames", "number", ["number", "number", "number"]);
+			this.tgbLink = Module.cwrap(
+				"tgbLink", "boolean", ["number", "number"]);
+			this.tgbUnlink = Module.cwrap(
+				"tgbUnlink", "void", ["number"]);
+			this.tgbGetFrame = Module.cwrap(
+				"tgbGetFrame", "number", ["number"]);
+			this.tgbGetAudio = Module.cwrap(
+				"tgbGetAudio", "number", ["number", "number"]);
+			this.tgbGetSram = Module.cwrap(
+				"tgbGetSram", "number", ["number"]);
+			this.tgbGetStateSize = Module.cwrap(
+				"tgbGetStateSize", "number", ["number"]);
+			this.tgbSaveStateMem = Module.cwrap(
+				"tgbSaveStateMem", "number", ["number", "number", "number"]);
+			this.tgbRestoreStateMem = Module.cwrap(
+				"tgbRestoreStateMem", "boolean", ["number", "number", "number"]);
+			this.tgbGetCounters = Module.cwrap(
+				"tgbGetCounters", "number", ["number"]);
+			this.tgbClearCounters = Module.cwrap(
+				"tgbClearCounters", "void", ["number"]);
+			this.tgbSetProfile = Module.cwrap(
+				"tgbSetProfile", "boolean", ["number", "number"]);
+			this.tgbClearProfile = Module.cwrap(
+				"tgbClearProfile", "void", ["number"]);
+			this.tgbLoadProfileSym = Module.cwrap(
+				"tgbLoadProfileSym", "boolean", ["number", "string"]);
+			this.tgbSaveProfileReport = Module.cwrap(
+				"tgbSaveProfileReport", "boolean", ["number", "string", "number"]);
+			this.tgbSetTrace = Module.cwrap(
+				"tgbSetTrace", "void", ["number", "boolean"]);
+			this.tgbSetTraceSize = Module.cwrap(
+				"tgbSetTraceSize", "void", ["number", "number"]);
+			this.tgbClearTrace = Module.cwrap(
+				"tgbClearTrace", "void", ["number"]);
+			this.tgbSaveTrace = Module.cwrap(
+				"tgbSaveTrace", "boolean", ["number", "string"]);
+			this.tgbAddBreakpoint = Module.cwrap(
+				"tgbAddBreakpoint", "number", ["number", "number", "number"]);
+			this.tgbAddWatchpoint = Module.cwrap(
+				"tgbAddWatchpoint", "number", ["number", "number", "number", "number"]);
+			this.tgbRemoveBreak = Module.cwrap(
+				"tgbRemoveBreak", "boolean", ["number", "number"]);
+			this.tgbClearBreaks = Module.cwrap(
+				"tgbClearBreaks", "void", ["number"]);
+			this.tgbGetBreakHit = Module.cwrap(
+				"tgbGetBreakHit", "number", ["number"]);
+			this.tgbResumeBreak = Module.cwrap(
+				"tgbResumeBreak", "void", ["number"]);
+			this.tgbSaveState = Module.cwrap(
+				"tgbSaveState", "void", ["number", "string"]);
+			this.tgbRestoreState = Module.cwrap(
+				"tgbRestoreState", "void", ["number", "string"]);
+			this.tgbSetRewind = Module.cwrap(
+				"tgbSetRewind", "void", ["number", "number", "number"]);
+			this.tgbRewindFrame = Module.cwrap(
+				"tgbRewindFrame", "boolean", ["number"]);
+			this.tgbGetRewindCount = Module.cwrap(
+				"tgbGetRewindCount", "number", ["number"]);
+			this.tgbSetSkip = Module.cwrap(
+				"tgbSetSkip", "void", ["number", "number"]);
+			this.tgbSaveSram = Module.cwrap(
+				"tgbSaveSram", "void", ["number", "string"]);
+			this.tgbSetSaveCompression = Module.cwrap(
+				"tgbSetSaveCompression", "void", ["number", "boolean"]);
+			this.tgbSaveStateAsync = Module.cwrap(
+				"tgbSaveStateAsync", "void", ["number", "string"]);
+			this.tgbSaveSramAsync = Module.cwrap(
+				"tgbSaveSramAsync", "void", ["number", "string"]);
+			this.tgbSetAutoSave = Module.cwrap(
+				"tgbSetAutoSave", "void", ["number", "string", "number"]);
+			this.tgbSetRunAhead = Module.cwrap(
+				"tgbSetRunAhead", "void", ["number", "number"]);
+			this.tgbSetRtcBase = Module.cwrap(
+				"tgbSetRtcBase", "void", ["number", "number"]);
+			this.tgbStartMovieRecord = Module.cwrap(
+				"tgbStartMovieRecord", "void", ["number", "boolean"]);
+			this.tgbSaveMovie = Module.cwrap(
+				"tgbSaveMovie", "boolean", ["number", "string"]);
+			this.tgbPlayMovie = Module.cwrap(
+				"tgbPlayMovie", "boolean", ["number", "string"]);
+			this.tgbStopMovie = Module.cwrap(
+				"tgbStopMovie", "void", ["number"]);
+			this.tgbGetMovieMode = Module.cwrap(
+				"tgbGetMovieMode", "number", ["number"]);
+			this.tgbGetMovieFrame = Module.cwrap(
+				"tgbGetMovieFrame", "number", ["number"]);
+			this.tgbGetMovieLength = Module.cwrap(
+				"tgbGetMovieLength", "number", ["number"]);
+			this.tgbPlayMovieFast = Module.cwrap(
+				"tgbPlayMovieFast", "number", ["number", "number"]);
+			this.tgbStartHashLog = Module.cwrap(
+				"tgbStartHashLog", "boolean", ["number", "string"]);
+			this.tgbStopHashLog = Module.cwrap(
+				"tgbStopHashLog", "void", ["number"]);
+			this.tgbCompareHashLogs = Module.cwrap(
+				"tgbCompareHashLogs", "number", ["number", "string", "string"]);
+			this.tgbGetHashLogDiffPart = Module.cwrap(
+				"tgbGetHashLogDiffPart", "number", ["number"]);
+			this.tgbGetFrameHash = Module.cwrap(
+				"tgbGetFrameHash", "number", ["number", "number"]);
+			this.tgbGetCartName = Module.cwrap(
+				"tgbGetCartName", "string", ["number"]);
+			this.tgbGetCartType = Module.cwrap(
+				"tgbGetCartType", "number", ["number"]);
+			this.tgbGetRomSize = Module.cwrap(
+				"tgbGetRomSize", "number", ["number"]);
+			this.tgbGetRamSize = Module.cwrap(
+				"tgbGetRamSize", "number", ["number"]);
+			this.tgbGetCheckSum = Module.cwrap(
+				"tgbGetCheckSum", "number", ["number"]);
+			this.tgbGetGBType = Module.cwrap(
+				"tgbGetGBType", "number", ["number"]);
+			this.tgbGetAudioF = Module.cwrap(
+				"tgbGetAudioF", "number", ["number", "number"]);
+			this.tgbGetSoundFill = Module.cwrap(
+				"tgbGetSoundFill", "number", ["number"]);
+			this.tgbEnableSoundStems = Module.cwrap(
+				"tgbEnableSoundStems", "void", ["number", "boolean"]);
+			this.tgbGetSoundStems = Module.cwrap(
+				"tgbGetSoundStems", "number", ["number", "number"]);
+			this.tgbRenderAudio = Module.cwrap(
+				"tgbRenderAudio", "number", ["number", "number"]);
+			this.tgbGetRenderedAudio = Module.cwrap(
+				"tgbGetRenderedAudio", "number", ["number"]);
+			this.tgbEnableSound = Module.cwrap(
+				"tgbEnableSound", "void", ["number", "boolean"]);
+			this.tgbEnableSoundChannel = Module.cwrap(
+				"tgbEnableSoundChannel", "void", ["number", "number", "boolean"]);
+			this.tgbEnableSoundEcho = Module.cwrap(
+				"tgbEnableSoundEcho", "void", ["number", "boolean"]);
+			this.tgbEnableSoundLowPass = Module.cwrap(
+				"tgbEnableSoundLowPass", "void", ["number", "boolean"]);
+			this.tgbEnableScreenLayer = Module.cwrap(
+				"tgbEnableScreenLayer", "void", ["number", "number", "boolean"]);
+			this.tgbSetGBType = Module.cwrap(
+				"tgbSetGBType", "void", ["number", "number"]);
 		}
 	}
 
@@ -671,6 +1344,47 @@ export module TgbDual {
 		public checkSum: number = 0; // 1
 		public gbType: number = 0; // 4
 	}
+
+	export class RunStatus {
+		public frames: number = 0;
+		public samples: number = 0;
+		public vblanks: number = 0;
+		public hit: boolean = false; // stopped on a breakpoint or watchpoint
+	}
+
+	// Same layout as break_hit in gb_core/debugger.h
+	export class BreakHit {
+		public id: number = 0;
+		public type: number = 0; // TgbDual.Break*
+		public pc: number = 0;
+		public bank: number = 0;
+		public address: number = 0; // watchpoints only
+		public data: number = 0; // value read or written
+		public line: number = 0;
+		public clock: number = 0;
+		public af: number = 0;
+		public bc: number = 0;
+		public de: number = 0;
+		public hl: number = 0;
+		public sp: number = 0;
+		public count: number = 0; // hits since resumeBreak
+	}
+
+	// Same layout as gb_counters in gb_core/counters.h (all uint32)
+	export class Counters {
+		public instructions: number = 0;
+		public opcodes: number[] = [];
+		public opcodesCb: number[] = [];
+		public reads: number[] = []; // indexed by TgbDual.Region*
+		public writes: number[] = [];
+		public romBankSwitches: number = 0;
+		public ramBankSwitches: number = 0;
+		public hdmaBytes: number = 0;
+		public apuWrites: number = 0;
+		public interrupts: number[] = []; // VBlank, LCDC, Timer, Serial, Pad
+		public linesRendered: number = 0;
+		public linesSkipped: number = 0;
+	}
 	
 	export class Callback extends EventEmitter {
 		public call(method: string, ...args: any[]): void {